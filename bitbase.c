@@ -0,0 +1,730 @@
+/**
+ * bitbase.c contains implementation for the functions and constants
+ * defined in the associated header file.
+ * @author Blake Herrera
+ * @date 2023-05-04
+ * @see bitbase.h
+ */
+
+#include "bitbase.h"
+#include "bitboard.h"
+#include "config.h"
+#include "error.h"
+#include "filemap.h"
+#include "move.h"
+#include "movegen.h"
+#include "piece.h"
+#include "square.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Longest path of a bitbase file
+#define MAX_PATH_LENGTH 1024
+
+/* An ending is coded from the codes of both sides, as 36 * white + black.
+ * A side's code is 6 * first + second, where first and second are its
+ * non-king pieces in descending order, counted from 1 for the pawn, and
+ * 0 for no piece. A larger side code is taken as the stronger side.
+ */
+#define SIDE_CODES 36
+#define NUM_ENDINGS (SIDE_CODES * SIDE_CODES)
+
+// The non-king pieces of a bitbase, at most two
+#define MAX_ENDING_PIECES (MAX_BITBASE_PIECES - 2)
+
+// Values stored in a bitbase file, 2 bits per position, 4 to a byte
+#define STORED_DRAW 0
+#define STORED_WIN 1
+#define STORED_LOSS 2
+#define STORED_INVALID 3
+
+// Status of a position while building, for the side to move
+#define UNKNOWN 0
+#define UNKNOWN_DRAWABLE 1  // some capture or promotion draws
+#define WIN 2
+#define LOSS 3
+#define DRAW 4
+#define INVALID 5
+
+// The same type of piece of the other color
+#define otherColor(piece) ((piece) < NUM_PIECES / 2 ? (piece) + NUM_PIECES / 2 : \
+                                                      (piece) - NUM_PIECES / 2)
+
+/* The non-king pieces of an ending as they are in its bitbase, white's
+ * then black's, each side's in descending order. A position is indexed
+ * by the side to move, the white king, the black king, then the pieces,
+ * 64 squares each, starting from the most significant.
+ */
+typedef struct Ending {
+    int code, numPieces, pieces[MAX_ENDING_PIECES];
+    size_t numPositions;
+} Ending;
+
+// The loaded bitbases, either mapped from files or built in memory
+static const unsigned char *bitbases[NUM_ENDINGS];
+static size_t bitbaseSizes[NUM_ENDINGS];
+static int bitbaseMapped[NUM_ENDINGS], numBitbases;
+
+// The ending being built, shared by the building threads
+static Ending building;
+static atomic_uchar *status, *moveCounts;
+
+// A slice of the positions or of the frontier, handled by one thread
+typedef struct BuildSlice {
+    const uint32_t *frontier;
+    size_t start, end;
+    uint32_t *found;  // positions decided by the thread
+    size_t numFound, capacity;
+} BuildSlice;
+
+/**
+ * Private function.
+ * Gets the code of one side's non-king pieces.
+ * @param types - The types of the pieces in descending order, white's.
+ * @param n - The number of pieces.
+ * @return The side's code.
+ */
+static int sideCode(const int *types, int n) {
+    return (n > 0 ? 6 * (types[0] + 1) : 0) + (n > 1 ? types[1] + 1 : 0);
+}
+
+/**
+ * Private function.
+ * Sets up an ending from both sides' pieces, with the stronger side as
+ * white.
+ * @param ending - Output for the ending.
+ * @param whiteTypes - The types of white's non-king pieces, descending.
+ * @param numWhite - The number of white's non-king pieces.
+ * @param blackTypes - The types of black's non-king pieces, descending.
+ * @param numBlack - The number of black's non-king pieces.
+ * @return TRUE if the sides were swapped. FALSE otherwise.
+ */
+static int setupEnding(Ending *ending, const int *whiteTypes, int numWhite,
+                       const int *blackTypes, int numBlack) {
+    int i, flip = sideCode(blackTypes, numBlack) > sideCode(whiteTypes, numWhite);
+    const int *strong = flip ? blackTypes : whiteTypes, *weak = flip ? whiteTypes : blackTypes;
+    int numStrong = flip ? numBlack : numWhite, numWeak = flip ? numWhite : numBlack;
+
+    ending->code = SIDE_CODES * sideCode(strong, numStrong) + sideCode(weak, numWeak);
+    ending->numPieces = numStrong + numWeak;
+    ending->numPositions = 2 * 64 * 64;
+    for(i=0; i<ending->numPieces; i++) {
+        ending->pieces[i] = i < numStrong ? strong[i] : otherColor(weak[i - numStrong]);
+        ending->numPositions *= 64;
+    }
+    return flip;
+}
+
+/**
+ * Private function.
+ * Sets up an ending from its code.
+ * @param ending - Output for the ending.
+ * @param code - The code of the ending.
+ * @return TRUE if the ending has few enough pieces for a bitbase.
+ * FALSE otherwise, in which case the ending isn't set up.
+ */
+static int endingFromCode(Ending *ending, int code) {
+    int types[2][2], n[2], side, c;
+    for(side=0; side<2; side++) {
+        c = side ? code % SIDE_CODES : code / SIDE_CODES;
+        n[side] = 0;
+        if(c / 6) {
+            types[side][n[side]++] = c / 6 - 1;
+        }
+        if(c % 6) {
+            types[side][n[side]++] = c % 6 - 1;
+        }
+    }
+    if(n[0] + n[1] > MAX_ENDING_PIECES) {
+        return 0;
+    }
+    setupEnding(ending, types[0], n[0], types[1], n[1]);
+    return 1;
+}
+
+/**
+ * Private function.
+ * Writes the name of an ending, like KRKP.
+ * @param ending - The ending.
+ * @param szName - Output buffer for the name, at least 7 characters.
+ */
+static void endingName(const Ending *ending, char *szName) {
+    int i, n = 0;
+    szName[n++] = 'K';
+    for(i=0; i<ending->numPieces; i++) {
+        if(ending->pieces[i] >= NUM_PIECES / 2 &&
+           (i == 0 || ending->pieces[i - 1] < NUM_PIECES / 2)) {
+            szName[n++] = 'K';
+        }
+        szName[n++] = PIECE_STR[ending->pieces[i] % (NUM_PIECES / 2)];
+    }
+    if(ending->numPieces == 0 || ending->pieces[ending->numPieces - 1] < NUM_PIECES / 2) {
+        szName[n++] = 'K';
+    }
+    szName[n] = '\0';
+}
+
+/**
+ * Private function.
+ * Reads an ending from its name. The sides may be given in either order.
+ * Endings with pawns on both sides are refused, since en passant isn't
+ * modelled and could change their results.
+ * @param ending - Output for the ending.
+ * @param szName - The name, like KRKP.
+ * @param length - The length of the name.
+ * @return TRUE if the name is valid and the ending is supported.
+ * FALSE otherwise.
+ */
+static int parseEnding(Ending *ending, const char *szName, int length) {
+    int types[2][MAX_ENDING_PIECES], n[2] = {0, 0}, side = -1, i, j, t;
+    const char *szType;
+    for(i=0; i<length; i++) {
+        if(szName[i] == 'K') {
+            if(++side > 1) {
+                return 0;
+            }
+        } else if(side < 0 || szName[i] == '\0' ||
+                  (szType = strchr(PIECE_STR, szName[i])) == NULL ||
+                  szType - PIECE_STR >= W_KING || n[0] + n[1] == MAX_ENDING_PIECES) {
+            return 0;
+        } else {
+            // Insert in descending order
+            t = szType - PIECE_STR;
+            for(j=n[side]++; j>0 && types[side][j - 1] < t; j--) {
+                types[side][j] = types[side][j - 1];
+            }
+            types[side][j] = t;
+        }
+    }
+    // Each side's pieces are in descending order, so a pawn is last
+    if(side != 1 || (n[0] && n[1] && types[0][n[0] - 1] == W_PAWN &&
+                     types[1][n[1] - 1] == W_PAWN)) {
+        return 0;
+    }
+    setupEnding(ending, types[0], n[0], types[1], n[1]);
+    return 1;
+}
+
+/**
+ * Private function.
+ * Gets the path of an ending's bitbase file.
+ * @param szDir - The directory of the file.
+ * @param ending - The ending.
+ * @param szPath - Output buffer for the path, MAX_PATH_LENGTH long.
+ */
+static void bitbasePath(const char *szDir, const Ending *ending, char *szPath) {
+    char szName[8];
+    endingName(ending, szName);
+    snprintf(szPath, MAX_PATH_LENGTH, "%s/%s.bb", szDir, szName);
+}
+
+/**
+ * Private function.
+ * Replaces the bitbase of an ending.
+ * @param code - The code of the ending.
+ * @param data - The bitbase, or NULL to only remove the old one.
+ * @param size - The size of the bitbase in bytes.
+ * @param mapped - TRUE if the bitbase is mapped from a file. FALSE if it
+ * was allocated.
+ */
+static void setBitbase(int code, const unsigned char *data, size_t size, int mapped) {
+    if(bitbases[code] != NULL) {
+        if(bitbaseMapped[code]) {
+            unmapFile(bitbases[code], bitbaseSizes[code]);
+        } else {
+            free((void*) bitbases[code]);
+        }
+        numBitbases--;
+    }
+    bitbases[code] = data;
+    bitbaseSizes[code] = size;
+    bitbaseMapped[code] = mapped;
+    numBitbases += data != NULL;
+}
+
+/**
+ * Private function.
+ * Maps an ending's bitbase file, if it is there and the right size.
+ * @param szDir - The directory of the file.
+ * @param ending - The ending.
+ * @return TRUE if the bitbase was loaded. FALSE otherwise.
+ */
+static int loadBitbase(const char *szDir, const Ending *ending) {
+    char szPath[MAX_PATH_LENGTH];
+    const unsigned char *data;
+    size_t size;
+
+    bitbasePath(szDir, ending, szPath);
+    data = mapFile(szPath, &size);
+    if(data == NULL) {
+        return 0;
+    }
+    if(size != (ending->numPositions + 3) / 4) {
+        unmapFile(data, size);
+        return 0;
+    }
+    setBitbase(ending->code, data, size, 1);
+    return 1;
+}
+
+int bitbaseLoad(const char *szDir) {
+    int code, loaded = 0;
+    char szName[8];
+    Ending ending, parsed;
+    for(code=0; code<NUM_ENDINGS; code++) {
+        // Skip codes which aren't an ending as its bitbase covers it
+        if(!endingFromCode(&ending, code)) {
+            continue;
+        }
+        endingName(&ending, szName);
+        if(parseEnding(&parsed, szName, strlen(szName)) && parsed.code == code) {
+            loaded += loadBitbase(szDir, &ending);
+        }
+    }
+    return loaded;
+}
+
+/**
+ * Private function.
+ * Gets the index of a position in its ending's bitbase.
+ * @param ending - The ending.
+ * @param turn - TRUE if white is to move in the bitbase.
+ * @param squares - The white king's square, the black king's square,
+ * then the squares of the ending's pieces. Two pieces of the same type
+ * and color may be in either order.
+ * @return The index of the position.
+ */
+static size_t encodePosition(const Ending *ending, int turn, const int *squares) {
+    size_t index = (turn * 64 + squares[0]) * 64 + squares[1];
+    int i;
+    if(ending->numPieces == 2 && ending->pieces[0] == ending->pieces[1] &&
+       squares[2] > squares[3]) {
+        return (index * 64 + squares[3]) * 64 + squares[2];
+    }
+    for(i=0; i<ending->numPieces; i++) {
+        index = index * 64 + squares[2 + i];
+    }
+    return index;
+}
+
+/**
+ * Private function.
+ * Sets up a position of an ending from its index. Only the bitboards and
+ * the side to move are set.
+ * @param ending - The ending.
+ * @param index - The index of the position.
+ * @param state - Output for the position.
+ * @param squares - Output for the squares, as encodePosition takes them.
+ * @return TRUE if the position is legal and the index is the one
+ * encodePosition gives it. FALSE otherwise.
+ */
+static int decodePosition(const Ending *ending, size_t index, GameState *state, int *squares) {
+    int i, piece;
+    bitmask bm;
+
+    for(i=ending->numPieces+1; i>=0; i--) {
+        squares[i] = index % 64;
+        index /= 64;
+    }
+    memset(state, 0, sizeof(GameState));
+    state->fenInfo = index;
+    for(i=0; i<ending->numPieces+2; i++) {
+        piece = i < 2 ? (i ? B_KING : W_KING) : ending->pieces[i - 2];
+        bm = 1ULL << squares[i];
+        if(state->bb[BLOCKERS] & bm ||
+           ((piece == W_PAWN || piece == B_PAWN) && bm & (RANK_1 | RANK_8))) {
+            return 0;
+        }
+        state->bb[piece] |= bm;
+        state->bb[BLOCKERS] |= bm;
+    }
+    // Two pieces of the same type are kept in ascending order
+    if(ending->numPieces == 2 && ending->pieces[0] == ending->pieces[1] &&
+       squares[2] > squares[3]) {
+        return 0;
+    }
+    return !(getTurn(*state) ? bInCheck(state) : wInCheck(state));
+}
+
+int bitbaseProbe(const GameState *state) {
+    int types[2][MAX_ENDING_PIECES], n[2] = {0, 0}, squares[MAX_BITBASE_PIECES],
+        side, type, flip, i, piece, stored;
+    bitmask bm;
+    size_t index;
+    Ending ending;
+
+    if(numBitbases == 0 || POPCOUNT(state->bb[BLOCKERS]) > MAX_BITBASE_PIECES ||
+       getCastlingRights(*state) || hasEPTarget(*state)) {
+        return BITBASE_UNKNOWN;
+    }
+    for(side=0; side<2; side++) {
+        for(type=W_QUEEN; type>=W_PAWN; type--) {
+            for(bm=state->bb[colorPiece(type, !side)]; bm; bm&=bm-1) {
+                types[side][n[side]++] = type;
+            }
+        }
+    }
+    flip = setupEnding(&ending, types[0], n[0], types[1], n[1]);
+    if(bitbases[ending.code] == NULL) {
+        return BITBASE_UNKNOWN;
+    }
+
+    // With the sides swapped, the board is mirrored and the colors reversed
+    squares[0] = (LSB(state->bb[flip ? B_KING : W_KING]) - 1) ^ (flip ? 56 : 0);
+    squares[1] = (LSB(state->bb[flip ? W_KING : B_KING]) - 1) ^ (flip ? 56 : 0);
+    for(i=0; i<ending.numPieces; i++) {
+        piece = flip ? otherColor(ending.pieces[i]) : ending.pieces[i];
+        bm = state->bb[piece];
+        if(i > 0 && ending.pieces[i] == ending.pieces[i - 1]) {
+            bm &= bm - 1;
+        }
+        squares[2 + i] = (LSB(bm) - 1) ^ (flip ? 56 : 0);
+    }
+    index = encodePosition(&ending, getTurn(*state) ^ flip, squares);
+    stored = bitbases[ending.code][index / 4] >> (index % 4 * 2) & 3;
+    return stored == STORED_WIN ? BITBASE_WIN :
+           stored == STORED_LOSS ? BITBASE_LOSS :
+           stored == STORED_DRAW ? BITBASE_DRAW : BITBASE_UNKNOWN;
+}
+
+/**
+ * Private function.
+ * Adds a decided position to a slice's list of them.
+ * @param slice - The slice.
+ * @param index - The index of the position.
+ */
+static void addFound(BuildSlice *slice, size_t index) {
+    if(slice->numFound == slice->capacity) {
+        slice->capacity = slice->capacity ? 2 * slice->capacity : 1024;
+        slice->found = realloc(slice->found, slice->capacity * sizeof(uint32_t));
+        errTrap(slice->found == NULL, "Error on realloc in addFound\n");
+    }
+    slice->found[slice->numFound++] = index;
+}
+
+/**
+ * Private function.
+ * Sets the starting status of each position in a slice of the ending
+ * being built. Checkmates are lost, stalemates drawn, and positions with
+ * a capture or promotion into a lost position for the opponent are won.
+ * Otherwise the moves staying in the ending are counted. Runs in its own
+ * thread.
+ * @param params - Pointer to the BuildSlice.
+ * @return NULL
+ */
+static void *initSlice(void *params) {
+    BuildSlice *slice = params;
+    GameState state, next;
+    Move moves[MAX_MOVES];
+    int squares[MAX_BITBASE_PIECES], numMoves, i, count, drawable, result;
+    unsigned char s;
+    size_t index;
+
+    for(index=slice->start; index<slice->end; index++) {
+        count = drawable = 0;
+        s = UNKNOWN;
+        if(!decodePosition(&building, index, &state, squares)) {
+            s = INVALID;
+        } else {
+            generateLegalMoves(&state, moves, &numMoves);
+            for(i=0; i<numMoves && s != WIN; i++) {
+                if(!isCapture(moves[i]) && !isPromotion(moves[i])) {
+                    count++;
+                    continue;
+                }
+                // Captures and promotions leave the ending for one already built
+                next = pushMove(&state, moves[i]);
+                result = bitbaseProbe(&next);
+                if(result == BITBASE_LOSS) {
+                    s = WIN;
+                } else if(result != BITBASE_WIN) {
+                    drawable = 1;
+                }
+            }
+            if(numMoves == 0) {
+                s = (getTurn(state) ? wInCheck(&state) : bInCheck(&state)) ? LOSS : DRAW;
+            } else if(s != WIN && count == 0) {
+                s = drawable ? DRAW : LOSS;
+            } else if(s != WIN && drawable) {
+                s = UNKNOWN_DRAWABLE;
+            }
+        }
+        atomic_init(&status[index], s);
+        atomic_init(&moveCounts[index], count);
+        if(s == WIN || s == LOSS) {
+            addFound(slice, index);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Private function.
+ * Gets the squares a piece could have moved from to its square, without
+ * capturing or promoting.
+ * @param piece - The piece.
+ * @param square - The piece's square.
+ * @param occupied - The occupied squares.
+ * @return The squares the piece could have moved from.
+ */
+static bitmask unmoveSquares(int piece, int square, bitmask occupied) {
+    bitmask from;
+    switch(piece) {
+        case W_PAWN:
+            from = (1ULL << square) >> 8 & ~occupied & ~RANK_1;
+            return from | ((from & RANK_3) >> 8 & ~occupied);
+        case B_PAWN:
+            from = (1ULL << square) << 8 & ~occupied & ~RANK_8;
+            return from | ((from & RANK_6) << 8 & ~occupied);
+        case W_KNIGHT:
+        case B_KNIGHT:
+            return KNIGHT_TABLE[square] & ~occupied;
+        case W_BISHOP:
+        case B_BISHOP:
+            return _calculateBishopMoves(square, occupied) & ~occupied;
+        case W_ROOK:
+        case B_ROOK:
+            return _calculateRookMoves(square, occupied) & ~occupied;
+        case W_QUEEN:
+        case B_QUEEN:
+            return (_calculateBishopMoves(square, occupied) |
+                    _calculateRookMoves(square, occupied)) & ~occupied;
+        default:
+            return KING_TABLE[square] & ~occupied;
+    }
+}
+
+/**
+ * Private function.
+ * Works back from each decided position in a slice of the frontier to
+ * the positions which could have moved to it. Those with a move to a
+ * lost position are won, and those whose moves in the ending all go to
+ * won positions are lost, unless a capture or promotion draws. Runs in
+ * its own thread.
+ * @param params - Pointer to the BuildSlice.
+ * @return NULL
+ */
+static void *retreatSlice(void *params) {
+    BuildSlice *slice = params;
+    GameState state;
+    int squares[MAX_BITBASE_PIECES], i, turn, piece, original;
+    unsigned char s, expected;
+    size_t f, prev;
+    bitmask bm;
+
+    for(f=slice->start; f<slice->end; f++) {
+        decodePosition(&building, slice->frontier[f], &state, squares);
+        s = atomic_load_explicit(&status[slice->frontier[f]], memory_order_relaxed);
+        turn = getTurn(state);
+        // Unmove each piece of the side which just moved
+        for(i=0; i<building.numPieces+2; i++) {
+            piece = i < 2 ? (i ? B_KING : W_KING) : building.pieces[i - 2];
+            if((piece < NUM_PIECES / 2) == turn) {
+                continue;
+            }
+            original = squares[i];
+            for(bm=unmoveSquares(piece, original, state.bb[BLOCKERS]); bm; bm&=bm-1) {
+                squares[i] = LSB(bm) - 1;
+                prev = encodePosition(&building, !turn, squares);
+                if(s == LOSS) {
+                    expected = UNKNOWN;
+                    if(atomic_compare_exchange_strong(&status[prev], &expected, WIN) ||
+                       (expected == UNKNOWN_DRAWABLE &&
+                        atomic_compare_exchange_strong(&status[prev], &expected, WIN))) {
+                        addFound(slice, prev);
+                    }
+                } else {
+                    expected = atomic_load_explicit(&status[prev], memory_order_relaxed);
+                    if((expected == UNKNOWN || expected == UNKNOWN_DRAWABLE) &&
+                       atomic_fetch_sub(&moveCounts[prev], 1) == 1) {
+                        expected = UNKNOWN;
+                        if(atomic_compare_exchange_strong(&status[prev], &expected, LOSS)) {
+                            addFound(slice, prev);
+                        }
+                    }
+                }
+            }
+            squares[i] = original;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Private function.
+ * Runs a pass of the build on numThreads threads, over either all the
+ * positions or the frontier, and collects the positions decided.
+ * @param work - initSlice or retreatSlice.
+ * @param frontier - The frontier, or NULL for all the positions.
+ * @param n - The number of positions or of frontier positions.
+ * @param numFound - Output for the number of positions decided.
+ * @return The positions decided, which must be freed.
+ */
+static uint32_t *runPass(void *(*work)(void*), const uint32_t *frontier, size_t n,
+                         size_t *numFound) {
+    int i, threads = numThreads < 1 ? 1 : numThreads;
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    BuildSlice *slices = malloc(threads * sizeof(BuildSlice));
+    uint32_t *found;
+
+    errTrap(workers == NULL || slices == NULL, "Error on malloc in runPass\n");
+    for(i=0; i<threads; i++) {
+        slices[i].frontier = frontier;
+        slices[i].start = n * i / threads;
+        slices[i].end = n * (i + 1) / threads;
+        slices[i].found = NULL;
+        slices[i].numFound = slices[i].capacity = 0;
+        errTrap(pthread_create(&workers[i], NULL, work, &slices[i]),
+                "Error on pthread_create in runPass\n");
+    }
+    *numFound = 0;
+    for(i=0; i<threads; i++) {
+        errTrap(pthread_join(workers[i], NULL), "Error on pthread_join in runPass\n");
+        *numFound += slices[i].numFound;
+    }
+    found = malloc((*numFound ? *numFound : 1) * sizeof(uint32_t));
+    errTrap(found == NULL, "Error on malloc in runPass\n");
+    for(i=0, n=0; i<threads; i++) {
+        if(slices[i].numFound) {
+            memcpy(found + n, slices[i].found, slices[i].numFound * sizeof(uint32_t));
+            n += slices[i].numFound;
+        }
+        free(slices[i].found);
+    }
+    free(workers);
+    free(slices);
+    return found;
+}
+
+/**
+ * Private function.
+ * Builds the bitbase of an ending whose captures and promotions lead to
+ * endings already loaded, and writes it to a file.
+ * @param szDir - The directory to write the file to.
+ * @param ending - The ending.
+ * @return 0 on success. Nonzero if the file could not be written.
+ */
+static int generateBitbase(const char *szDir, const Ending *ending) {
+    char szPath[MAX_PATH_LENGTH];
+    uint32_t *frontier, *found;
+    size_t n, numFound, index, counts[4] = {0, 0, 0, 0};
+    unsigned char *packed, s, stored;
+    FILE *file;
+    int written;
+
+    building = *ending;
+    status = malloc(ending->numPositions);
+    moveCounts = malloc(ending->numPositions);
+    packed = calloc((ending->numPositions + 3) / 4, 1);
+    errTrap(status == NULL || moveCounts == NULL || packed == NULL,
+            "Error on malloc in generateBitbase\n");
+
+    frontier = runPass(initSlice, NULL, ending->numPositions, &n);
+    while(n) {
+        found = runPass(retreatSlice, frontier, n, &numFound);
+        free(frontier);
+        frontier = found;
+        n = numFound;
+    }
+    free(frontier);
+
+    // Positions still undecided can't be forced either way
+    for(index=0; index<ending->numPositions; index++) {
+        s = atomic_load_explicit(&status[index], memory_order_relaxed);
+        stored = s == WIN ? STORED_WIN : s == LOSS ? STORED_LOSS :
+                 s == INVALID ? STORED_INVALID : STORED_DRAW;
+        packed[index / 4] |= stored << (index % 4 * 2);
+        counts[stored]++;
+    }
+    free(status);
+    free(moveCounts);
+
+    bitbasePath(szDir, ending, szPath);
+    file = fopen(szPath, "wb");
+    written = file != NULL &&
+              fwrite(packed, 1, (ending->numPositions + 3) / 4, file) ==
+              (ending->numPositions + 3) / 4;
+    if(file == NULL || fclose(file) != 0 || !written) {
+        free(packed);
+        return 1;
+    }
+    printf("Wrote %s: %zu won, %zu drawn, %zu lost, %zu illegal\n", szPath,
+           counts[STORED_WIN], counts[STORED_DRAW], counts[STORED_LOSS], counts[STORED_INVALID]);
+    fflush(stdout);
+    setBitbase(ending->code, packed, (ending->numPositions + 3) / 4, 0);
+    return 0;
+}
+
+/**
+ * Private function.
+ * Loads or builds the bitbase of an ending, after those of the endings
+ * its captures and promotions lead to.
+ * @param szDir - The directory of the bitbase files.
+ * @param ending - The ending.
+ * @return 0 on success. Nonzero if a file could not be written.
+ */
+static int ensureBitbase(const char *szDir, const Ending *ending) {
+    int types[2][MAX_ENDING_PIECES], n[2], i, j, side, promotion;
+    Ending next;
+
+    if(bitbases[ending->code] != NULL || loadBitbase(szDir, ending)) {
+        return 0;
+    }
+    for(i=0; i<ending->numPieces; i++) {
+        // Each piece captured, then each pawn promoted
+        for(promotion=W_PAWN; promotion<=W_QUEEN; promotion++) {
+            if(promotion != W_PAWN && ending->pieces[i] % (NUM_PIECES / 2) != W_PAWN) {
+                break;
+            }
+            n[0] = n[1] = 0;
+            for(j=0; j<ending->numPieces; j++) {
+                side = ending->pieces[j] >= NUM_PIECES / 2;
+                if(j != i) {
+                    types[side][n[side]++] = ending->pieces[j] % (NUM_PIECES / 2);
+                } else if(promotion != W_PAWN) {
+                    types[side][n[side]++] = promotion;
+                }
+            }
+            // Keep each side in descending order
+            for(side=0; side<2; side++) {
+                if(n[side] == 2 && types[side][0] < types[side][1]) {
+                    j = types[side][0];
+                    types[side][0] = types[side][1];
+                    types[side][1] = j;
+                }
+            }
+            setupEnding(&next, types[0], n[0], types[1], n[1]);
+            if(ensureBitbase(szDir, &next)) {
+                return 1;
+            }
+        }
+    }
+    return generateBitbase(szDir, ending);
+}
+
+int buildBitbases(const char *szDir, const char *szEndings) {
+    Ending ending;
+    int length;
+    char szName[8];
+
+    while(*(szEndings += strspn(szEndings, ", ")) != '\0') {
+        length = strcspn(szEndings, ", ");
+        if(!parseEnding(&ending, szEndings, length)) {
+            fprintf(stderr, "Not a supported ending of at most %d pieces: %.*s\n",
+                    MAX_BITBASE_PIECES, length, szEndings);
+            return 1;
+        }
+        if(ensureBitbase(szDir, &ending)) {
+            endingName(&ending, szName);
+            fprintf(stderr, "Could not write the bitbase for %s to %s\n", szName, szDir);
+            return 1;
+        }
+        szEndings += length;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+/**
+ * bitbase.h contains endgame bitbases: tables of whether each position
+ * of an ending with at most four pieces is won, drawn or lost for the
+ * side to move, assuming perfect play and ignoring the 50 move rule.
+ * Bitbases are built by retrograde analysis, working back from the
+ * checkmates with an unmove generator, and are written as files named
+ * after the ending, like KBNK.bb, which are memory mapped for probing.
+ *
+ * An ending is named by the white pieces then the black pieces, each
+ * starting with the king and in the order Q, R, B, N, P. A bitbase only
+ * covers the ending with the stronger side as white. Positions with the
+ * colors reversed are probed through the same bitbase. Endings with
+ * pawns on both sides, like KPKP, have no bitbase, since en passant
+ * isn't modelled.
+ * @author Blake Herrera
+ * @date 2023-05-04
+ */
+
+#ifndef BITBASE_H_INCLUDED
+#define BITBASE_H_INCLUDED
+
+#include "position.h"
+
+// Positions with more pieces than this, kings included, are never probed
+#define MAX_BITBASE_PIECES 4
+
+// Results of a probe, for the side to move
+#define BITBASE_LOSS -1
+#define BITBASE_DRAW 0
+#define BITBASE_WIN 1
+#define BITBASE_UNKNOWN 2
+
+/**
+ * Probes the bitbase of a position's ending. Positions with castling
+ * rights or an en passant target are not probed.
+ * @param state - Pointer to the position.
+ * @return BITBASE_WIN, BITBASE_DRAW or BITBASE_LOSS for the side to move,
+ * or BITBASE_UNKNOWN if the ending's bitbase isn't loaded.
+ */
+int bitbaseProbe(const GameState *state);
+
+/**
+ * Loads every bitbase file found in a directory, replacing any bitbase
+ * already loaded for the same ending.
+ * @param szDir - The directory of the bitbase files.
+ * @return The number of bitbases loaded.
+ */
+int bitbaseLoad(const char *szDir);
+
+/**
+ * Builds the bitbases of the given endings on numThreads threads, along
+ * with the bitbases of the endings they can reach by a capture or a
+ * promotion, and writes them to a directory. Bitbases whose files are
+ * already in the directory are loaded instead of built. The built
+ * bitbases can be probed right away.
+ * @param szDir - The directory to write the bitbase files to.
+ * @param szEndings - The names of the endings, separated by commas or
+ * spaces, like "KPK,KRK,KQK,KBNK".
+ * @return 0 on success. Nonzero if an ending's name is not valid, the
+ * ending has pawns on both sides, or a file could not be written.
+ */
+int buildBitbases(const char *szDir, const char *szEndings);
+
+#endif // BITBASE_H_INCLUDED
@@ -126,7 +126,5 @@ bitmask getBlockers(bitmask *bb) {
 }
 
 int sumBits(bitmask bm) {
-    int i;
-    for(i=0; bm; i++, bm &= ~(1ULL << (LSB(bm) - 1)));
-    return i;
+    return POPCOUNT(bm);
 }
@@ -36,6 +36,13 @@
 
 // Least Significant Bit
 #define LSB __builtin_ffsll
+// Number of 1 bits
+#define POPCOUNT __builtin_popcountll
+
+/* For helpers taking a constant color, so that each caller gets its own
+ * copy with the color's pieces, directions and ranks folded in.
+ */
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
 
 typedef unsigned long long int bitmask;
 
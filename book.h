@@ -0,0 +1,44 @@
+/**
+ * book.h contains probing of opening books in the Polyglot format.
+ * A book is a file of 16 byte entries sorted by the Polyglot key of
+ * their positions, each holding a key, a move and the move's weight,
+ * stored big-endian. The file is memory mapped and searched in place.
+ * @author Blake Herrera
+ * @date 2023-05-03
+ * @see http://hgm.nubati.net/book_format.html
+ */
+
+#ifndef BOOK_H_INCLUDED
+#define BOOK_H_INCLUDED
+
+#include "bitboard.h"
+#include "move.h"
+#include "position.h"
+
+/**
+ * Gets the Polyglot key of a position. This differs from the position's
+ * own key, since books must use the keys in the Polyglot format. The en
+ * passant file is only hashed when a pawn can capture en passant.
+ * @param state - Pointer to the position.
+ * @return The Polyglot key.
+ */
+bitmask polyglotKey(const GameState *state);
+
+/**
+ * Opens an opening book, closing the book opened before it.
+ * @param szPath - The path of the book.
+ * @return 0 on success. Nonzero if the book could not be mapped, in
+ * which case no book is open.
+ */
+int bookLoad(const char *szPath);
+
+/**
+ * Picks a book move for a position at random, each move with a chance
+ * proportional to its weight.
+ * @param state - Pointer to the position.
+ * @return A legal book move, or NULL_MOVE if no book is open or the
+ * position isn't in it.
+ */
+Move bookMove(const GameState *state);
+
+#endif // BOOK_H_INCLUDED
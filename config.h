@@ -12,16 +12,42 @@
  *     2 - null move pruning
  *     4 - forward pruning
  *     8 - transposition tables
+ *     16 - late move reductions
+ *     32 - late move pruning
+ *     64 - futility pruning
+ *     128 - reverse futility pruning
+ *     256 - razoring
  * evaluation:
  *     0 - piece * value count
  *     1 - custom function 1
  *     2 - custom function 2
+ *     3 - attack maps (safe mobility, king zone attacks, hanging pieces)
+ *     4 - tapered piece-square tables
+ *     5 - tapered piece-square tables + pawn structure
+ *     6 - neural network loaded from nnueFile (see nnue.h)
  *
  * Other options:
  * forwardPruneN - forward pruning value
+ * quiescenceMaxDepth - maximum depth of the quiescence search
+ * nullMoveVerifyDepth - minimum depth to verify a null move cutoff
+ * deltaMargin - pawn value added to a capture before delta pruning it
+ * futilityMargin - pawn value per ply a quiet move is assumed to gain
+ * reverseFutilityMargin - pawn value per ply the opponent may regain
+ * razorMargin - pawn value per ply before dropping into quiescence
+ * lazyEvalMargin - pawn value the material can be outside the search
+ *                  window before the rest of the evaluation is skipped
  * numThreads - number of threads
  * mobilityFactor - pawn value of a pseudo-legal move
+ * safeMobilityWeight - pawn value of a square attacked outside enemy pawns
+ * kingAttackWeight - pawn value of an attack on the enemy king's zone
+ * hangingPieceWeight - pawn value of an attacked, undefended enemy piece
+ * passedPawnWeight - pawn value of each rank a passed pawn has advanced
+ * isolatedPawnWeight - pawn value lost for a pawn with no pawns beside it
+ * doubledPawnWeight - pawn value lost for each pawn behind another
+ * backwardPawnWeight - pawn value lost for a pawn left behind its neighbors
+ * pawnShieldWeight - pawn value of a pawn in front of its king
  * timeUseFraction - maxmimum fraction of time to spend on move evaluation
+ * ownBook - whether to play moves from the book opened with BookFile
  *
  * @author Blake Herrera
  * @date 2023-04-13
@@ -32,6 +58,7 @@
 
 #include "position.h"
 #include "evaluate.h"
+#include "nnue.h"
 
 #define RANDOM_MOVES 0
 #define MINIMAX 1
@@ -42,17 +69,52 @@
 #define NULL_PRUNING 2
 #define FORWARD_PRUNING 4
 #define TRASPOSITION_TABLES 8
+#define LATE_MOVE_REDUCTIONS 16
+#define LATE_MOVE_PRUNING 32
+#define FUTILITY_PRUNING 64
+#define REVERSE_FUTILITY_PRUNING 128
+#define RAZORING 256
 
-#define NUM_EVALUATION_FUNCS 3
+/* The search is compiled separately for this configuration, so that
+ * the switches it leaves off cost nothing. Any other configuration
+ * uses the generic search, which tests the switches at run time.
+ */
+#define PRODUCTION_STRATEGY MINIMAX_QUIESCENCE
+#define PRODUCTION_PRUNING (AB_PRUNING | NULL_PRUNING | LATE_MOVE_REDUCTIONS | \
+                            LATE_MOVE_PRUNING | FUTILITY_PRUNING | \
+                            REVERSE_FUTILITY_PRUNING | RAZORING)
+
+#define NUM_EVALUATION_FUNCS 7
 #define MATERIAL_EVAL 0
 #define MATERIAL_AND_INFLUENCE 1
 #define MATERIAL_AND_MOBILITY 2
+#define ATTACK_MAP_EVAL 3
+#define PIECE_SQUARE_EVAL 4
+#define POSITIONAL_EVAL 5
+#define NNUE_EVAL 6
+
+/* Lists each evaluation as X(index, function, suffix), where suffix
+ * names the search instances compiled for it in search.c.
+ */
+#define EVALUATION_FUNCS(X) \
+    X(MATERIAL_EVAL, materialEval, Material) \
+    X(MATERIAL_AND_INFLUENCE, valueAndInfluence, Influence) \
+    X(MATERIAL_AND_MOBILITY, valueAndMobility, Mobility) \
+    X(ATTACK_MAP_EVAL, attackMapEval, AttackMap) \
+    X(PIECE_SQUARE_EVAL, pieceSquareEval, PieceSquare) \
+    X(POSITIONAL_EVAL, positionalEval, Positional) \
+    X(NNUE_EVAL, nnueEval, Nnue)
 
 extern int searchStrategy, pruning, evaluation, maxSearchDepth,
-           forwardPruneN, quiescenceMaxDepth, numThreads;
+           forwardPruneN, quiescenceMaxDepth, nullMoveVerifyDepth, numThreads,
+           ownBook;
 extern double pieceValues[NUM_PIECES + 1], mobilityFactor, timeUseFraction,
-              quiescenceCutoff;
-extern double (*evaluationFunction)(GameState);
-extern double (*evaluationFunctions[NUM_EVALUATION_FUNCS])(GameState);
+              deltaMargin, futilityMargin, reverseFutilityMargin, razorMargin,
+              lazyEvalMargin,
+              safeMobilityWeight, kingAttackWeight, hangingPieceWeight,
+              passedPawnWeight, isolatedPawnWeight, doubledPawnWeight,
+              backwardPawnWeight, pawnShieldWeight;
+extern double (*evaluationFunction)(const GameState*);
+extern double (*evaluationFunctions[NUM_EVALUATION_FUNCS])(const GameState*);
 
 #endif // CONFIG_H_INCLUDED
@@ -0,0 +1,116 @@
+/**
+ * dataset.c contains implementation for the functions and constants
+ * defined in the associated header file.
+ * @author Blake Herrera
+ * @date 2023-05-02
+ * @see dataset.h
+ */
+
+#include "dataset.h"
+#include "error.h"
+#include "filemap.h"
+
+#include <stdlib.h>
+
+/**
+ * Private function.
+ * Generates a pseudo-random number with xorshift64*.
+ * @param seed - Pointer to the generator's state, which must not be 0.
+ * @return A pseudo-random 64 bit number.
+ */
+static bitmask nextRandom(bitmask *seed) {
+    *seed ^= *seed >> 12;
+    *seed ^= *seed << 25;
+    *seed ^= *seed >> 27;
+    return *seed * 2685821657736338717ULL;
+}
+
+/**
+ * Private function.
+ * Gets the greatest common divisor of two numbers.
+ * @param a - The first number.
+ * @param b - The second number.
+ * @return The greatest common divisor.
+ */
+static size_t gcd(size_t a, size_t b) {
+    size_t t;
+    while(b) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/**
+ * Private function.
+ * Shuffles the order of the chunks with a Fisher-Yates shuffle.
+ * @param dataset - The dataset.
+ */
+static void shuffleChunks(PackedDataset *dataset) {
+    size_t i, j, t;
+    for(i=dataset->numChunks-1; i>0; i--) {
+        j = nextRandom(&dataset->seed) % (i + 1);
+        t = dataset->chunkOrder[i];
+        dataset->chunkOrder[i] = dataset->chunkOrder[j];
+        dataset->chunkOrder[j] = t;
+    }
+    dataset->nextChunk = 0;
+}
+
+int openDataset(PackedDataset *dataset, const char *szPath, size_t chunkSize, bitmask seed) {
+    size_t i;
+
+    dataset->positions = mapFile(szPath, &dataset->size);
+    if(dataset->positions == NULL) {
+        return 1;
+    }
+    dataset->numPositions = dataset->size / sizeof(PackedPosition);
+    if(dataset->numPositions == 0) {
+        unmapFile(dataset->positions, dataset->size);
+        return 1;
+    }
+    dataset->chunkSize = chunkSize < 1 ? 1 : chunkSize;
+    dataset->numChunks = (dataset->numPositions + dataset->chunkSize - 1) / dataset->chunkSize;
+    dataset->chunkOrder = malloc(dataset->numChunks * sizeof(size_t));
+    errTrap(dataset->chunkOrder == NULL, "Error on malloc in openDataset\n");
+    for(i=0; i<dataset->numChunks; i++) {
+        dataset->chunkOrder[i] = i;
+    }
+    dataset->seed = seed ? seed : 1;
+    errTrap(pthread_mutex_init(&dataset->lock, NULL),
+            "Error on pthread_mutex_init in openDataset\n");
+    shuffleChunks(dataset);
+    return 0;
+}
+
+int nextDatasetChunk(PackedDataset *dataset, DatasetChunk *chunk) {
+    size_t start;
+    int served = 1;
+
+    errTrap(pthread_mutex_lock(&dataset->lock),
+            "Error on pthread_mutex_lock in nextDatasetChunk\n");
+    if(dataset->nextChunk == dataset->numChunks) {
+        shuffleChunks(dataset);
+        served = 0;
+    } else {
+        start = dataset->chunkOrder[dataset->nextChunk++] * dataset->chunkSize;
+        chunk->positions = dataset->positions + start;
+        chunk->n = dataset->numPositions - start < dataset->chunkSize ?
+                   dataset->numPositions - start : dataset->chunkSize;
+        chunk->offset = nextRandom(&dataset->seed) % chunk->n;
+        do {
+            chunk->stride = nextRandom(&dataset->seed) % chunk->n + 1;
+        } while(gcd(chunk->stride, chunk->n) != 1);
+    }
+    errTrap(pthread_mutex_unlock(&dataset->lock),
+            "Error on pthread_mutex_unlock in nextDatasetChunk\n");
+    return served;
+}
+
+void closeDataset(PackedDataset *dataset) {
+    unmapFile(dataset->positions, dataset->size);
+    free(dataset->chunkOrder);
+    errTrap(pthread_mutex_destroy(&dataset->lock),
+            "Error on pthread_mutex_destroy in closeDataset\n");
+}
@@ -0,0 +1,74 @@
+/**
+ * dataset.h contains a reader for files of PackedPositions, like those
+ * written by generateTrainingData. The file is memory mapped and its
+ * positions are served in place, a chunk at a time, with the chunks in a
+ * shuffled order and the positions within each chunk visited in a
+ * shuffled order too, so that multi-gigabyte files can be read in a
+ * random order without copying them or loading them whole.
+ * @author Blake Herrera
+ * @date 2023-05-02
+ */
+
+#ifndef DATASET_H_INCLUDED
+#define DATASET_H_INCLUDED
+
+#include "bitboard.h"
+#include "position.h"
+
+#include <pthread.h>
+#include <stddef.h>
+
+/* The positions of a chunk are visited in the order
+ * (offset + i * stride) % n, which is a permutation since the stride and
+ * n are coprime.
+ */
+typedef struct DatasetChunk {
+    const PackedPosition *positions;
+    size_t n, offset, stride;
+} DatasetChunk;
+
+typedef struct PackedDataset {
+    const PackedPosition *positions;
+    size_t numPositions, size, chunkSize, numChunks, nextChunk, *chunkOrder;
+    bitmask seed;
+    pthread_mutex_t lock;
+} PackedDataset;
+
+/**
+ * Opens a file of PackedPositions. A trailing partial record is ignored.
+ * @param dataset - The dataset to open.
+ * @param szPath - The path of the file.
+ * @param chunkSize - The number of positions in each chunk.
+ * @param seed - The seed of the shuffle. The same seed gives the same order.
+ * @return 0 on success. Nonzero if the file could not be mapped or has
+ * no positions.
+ */
+int openDataset(PackedDataset *dataset, const char *szPath, size_t chunkSize, bitmask seed);
+
+/**
+ * Gets the next chunk of positions. Once every chunk has been served,
+ * returns FALSE once, and the chunks are shuffled again for the next
+ * pass. Safe to call from several threads.
+ * @param dataset - The dataset.
+ * @param chunk - Output for the chunk.
+ * @return TRUE if a chunk was served. FALSE at the end of a pass.
+ */
+int nextDatasetChunk(PackedDataset *dataset, DatasetChunk *chunk);
+
+/**
+ * Unmaps a dataset's file and frees its memory.
+ * @param dataset - The dataset to close.
+ */
+void closeDataset(PackedDataset *dataset);
+
+/**
+ * Gets a position of a chunk in its shuffled order.
+ * @param chunk - The chunk.
+ * @param i - The index of the position, less than the chunk's n.
+ * @return A pointer to the position, within the mapped file.
+ */
+ALWAYS_INLINE const PackedPosition *chunkPosition(const DatasetChunk *chunk, size_t i) {
+    return &chunk->positions[(chunk->offset + i * chunk->stride) % chunk->n];
+}
+
+#endif // DATASET_H_INCLUDED
@@ -11,30 +11,149 @@
 #include "config.h"
 #include "move.h"
 #include "movegen.h"
+#include "magic.h"
 #include "debug.h"
+#include "error.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+double PST_MIDGAME[NUM_PIECES + 1][NUM_SQUARES],
+       PST_ENDGAME[NUM_PIECES + 1][NUM_SQUARES];
+
+const int PHASE_WEIGHT[NUM_PIECES + 1] = {
+    0, 1, 1, 2, 4, 0, 0, 1, 1, 2, 4, 0, 0
+};
+
+/* White's tables in centipawns, laid out as the board is seen from
+ * white's side: a8 is first and h1 is last. Knights, bishops, rooks and
+ * queens use the same table in the middlegame and endgame.
+ */
+static const int PST_BASE[NUM_PIECES / 2][NUM_SQUARES] = {
+    {   // Pawn
+          0,   0,   0,   0,   0,   0,   0,   0,
+         50,  50,  50,  50,  50,  50,  50,  50,
+         10,  10,  20,  30,  30,  20,  10,  10,
+          5,   5,  10,  25,  25,  10,   5,   5,
+          0,   0,   0,  20,  20,   0,   0,   0,
+          5,  -5, -10,   0,   0, -10,  -5,   5,
+          5,  10,  10, -20, -20,  10,  10,   5,
+          0,   0,   0,   0,   0,   0,   0,   0
+    }, {    // Knight
+        -50, -40, -30, -30, -30, -30, -40, -50,
+        -40, -20,   0,   0,   0,   0, -20, -40,
+        -30,   0,  10,  15,  15,  10,   0, -30,
+        -30,   5,  15,  20,  20,  15,   5, -30,
+        -30,   0,  15,  20,  20,  15,   0, -30,
+        -30,   5,  10,  15,  15,  10,   5, -30,
+        -40, -20,   0,   5,   5,   0, -20, -40,
+        -50, -40, -30, -30, -30, -30, -40, -50
+    }, {    // Bishop
+        -20, -10, -10, -10, -10, -10, -10, -20,
+        -10,   0,   0,   0,   0,   0,   0, -10,
+        -10,   0,   5,  10,  10,   5,   0, -10,
+        -10,   5,   5,  10,  10,   5,   5, -10,
+        -10,   0,  10,  10,  10,  10,   0, -10,
+        -10,  10,  10,  10,  10,  10,  10, -10,
+        -10,   5,   0,   0,   0,   0,   5, -10,
+        -20, -10, -10, -10, -10, -10, -10, -20
+    }, {    // Rook
+          0,   0,   0,   0,   0,   0,   0,   0,
+          5,  10,  10,  10,  10,  10,  10,   5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+          0,   0,   0,   5,   5,   0,   0,   0
+    }, {    // Queen
+        -20, -10, -10,  -5,  -5, -10, -10, -20,
+        -10,   0,   0,   0,   0,   0,   0, -10,
+        -10,   0,   5,   5,   5,   5,   0, -10,
+         -5,   0,   5,   5,   5,   5,   0,  -5,
+          0,   0,   5,   5,   5,   5,   0,  -5,
+        -10,   5,   5,   5,   5,   5,   0, -10,
+        -10,   0,   5,   0,   0,   0,   0, -10,
+        -20, -10, -10,  -5,  -5, -10, -10, -20
+    }, {    // King
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -20, -30, -30, -40, -40, -30, -30, -20,
+        -10, -20, -20, -20, -20, -20, -20, -10,
+         20,  20,   0,   0,   0,   0,  20,  20,
+         20,  30,  10,   0,   0,  10,  30,  20
+    }
+};
+
+// In the endgame pawns should advance and the king should centralize
+static const int PAWN_ENDGAME[NUM_SQUARES] = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+     80,  80,  80,  80,  80,  80,  80,  80,
+     50,  50,  50,  50,  50,  50,  50,  50,
+     30,  30,  30,  30,  30,  30,  30,  30,
+     20,  20,  20,  20,  20,  20,  20,  20,
+     10,  10,  10,  10,  10,  10,  10,  10,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0
+};
+
+static const int KING_ENDGAME[NUM_SQUARES] = {
+    -50, -40, -30, -20, -20, -30, -40, -50,
+    -30, -20, -10,   0,   0, -10, -20, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -30,   0,   0,   0,   0, -30, -30,
+    -50, -30, -30, -30, -30, -30, -30, -50
+};
+
+void evaluateInit() {
+    int piece, square;
+    const int *endgame;
+    for(piece=W_PAWN; piece<=W_KING; piece++) {
+        endgame = piece == W_PAWN ? PAWN_ENDGAME :
+                  piece == W_KING ? KING_ENDGAME : PST_BASE[piece];
+        for(square=0; square<NUM_SQUARES; square++) {
+            // Flipping the rank turns a square into its table index
+            PST_MIDGAME[piece][square] = PST_BASE[piece][square ^ 56] / 100.0;
+            PST_ENDGAME[piece][square] = endgame[square ^ 56] / 100.0;
+            // Black's tables are mirrored and negated
+            PST_MIDGAME[piece + NUM_PIECES / 2][square] = -PST_BASE[piece][square] / 100.0;
+            PST_ENDGAME[piece + NUM_PIECES / 2][square] = -endgame[square] / 100.0;
+        }
+    }
+    // The blockers index stands for no piece, as with pieceValues
+    for(square=0; square<NUM_SQUARES; square++) {
+        PST_MIDGAME[NUM_PIECES][square] = PST_ENDGAME[NUM_PIECES][square] = 0;
+    }
+}
 
 void setMaterialScore(GameState *state) {
-    int i;
+    int i, square;
+    bitmask bm;
     state->material = 0;
+    state->pstMidgame = state->pstEndgame = 0;
+    state->phase = 0;
     for(i=0; i<NUM_PIECES; i++) {
         state->material += sumBits(state->bb[i]) * pieceValues[i];
+        state->phase += sumBits(state->bb[i]) * PHASE_WEIGHT[i];
+        for(bm = state->bb[i]; bm; bm &= bm - 1) {
+            square = LSB(bm) - 1;
+            state->pstMidgame += PST_MIDGAME[i][square];
+            state->pstEndgame += PST_ENDGAME[i][square];
+        }
     }
 }
 
-double materialEval(GameState state) {
-    return state.material;
-}
-
-double valueAndInfluence(GameState state) {
-    int wMoves, bMoves, turn = getTurn(state);
-    Move moveBuffer[MAX_MOVES];
+double valueAndInfluence(const GameState *state) {
+    int wMoves, bMoves, turn = getTurn(*state);
     double mobility;
 
-    setTurn(state, 1);
-    generatePseudoLegalMoves(&state, moveBuffer, &wMoves);
-    setTurn(state, 0);
-    generatePseudoLegalMoves(&state, moveBuffer, &bMoves);
-
+    wMoves = countPseudoLegalMoves(state, 1);
+    bMoves = countPseudoLegalMoves(state, 0);
 
     // Make the engine prefer to have more moves?
     #define INITIATIVE 1.00001
@@ -43,19 +162,16 @@ double valueAndInfluence(GameState state) {
     } else {
         mobility = wMoves - bMoves * INITIATIVE;
     }
-    return state.material + mobility * mobilityFactor;
+    return state->material + mobility * mobilityFactor;
     #undef INITIATIVE
 }
 
-double valueAndMobility(GameState state) {
-    int wMoves, bMoves, turn = getTurn(state);
-    Move moveBuffer[MAX_MOVES];
+double valueAndMobility(const GameState *state) {
+    int wMoves, bMoves, turn = getTurn(*state);
     double mobility;
 
-    setTurn(state, 1);
-    generateLegalMoves(&state, moveBuffer, &wMoves);
-    setTurn(state, 0);
-    generateLegalMoves(&state, moveBuffer, &bMoves);
+    wMoves = countLegalMoves(state, 1);
+    bMoves = countLegalMoves(state, 0);
 
     // Make the engine prefer to have more moves?
     #define INITIATIVE 1.00001
@@ -64,6 +180,268 @@ double valueAndMobility(GameState state) {
     } else {
         mobility = wMoves - bMoves * INITIATIVE;
     }
-    return state.material + mobility * mobilityFactor;
+    return state->material + mobility * mobilityFactor;
     #undef INITIATIVE
 }
+
+/**
+ * Private function.
+ * Builds one side's attacks, one piece at a time.
+ * @param state - Pointer to the current game state.
+ * @param white - TRUE for white's attacks. FALSE for black's.
+ * @param unsafe - Squares attacked by enemy pawns, or occupied by the
+ * side's own pieces, which don't count for mobility.
+ * @param kingZone - The enemy king and the squares around it.
+ * @param mobility - Output for the number of safe squares attacked.
+ * @param kingAttacks - Output for the number of attacks on the king zone.
+ * @return A bitmask of all squares the side attacks.
+ */
+static bitmask sideAttacks(const GameState *state, int white, bitmask unsafe,
+                           bitmask kingZone, int *mobility, int *kingAttacks) {
+    int square;
+    bitmask bm, attacks, all = NO_SQUARES, blockers = state->bb[BLOCKERS];
+
+    *mobility = *kingAttacks = 0;
+    #define addAttacks(piece, lookup) \
+        for(bm = state->bb[colorPiece(piece, white)]; bm; bm &= bm - 1) { \
+            square = LSB(bm) - 1; \
+            attacks = lookup; \
+            all |= attacks; \
+            *mobility += POPCOUNT(attacks & ~unsafe); \
+            *kingAttacks += POPCOUNT(attacks & kingZone); \
+        }
+    addAttacks(W_KNIGHT, KNIGHT_TABLE[square]);
+    addAttacks(W_BISHOP, hashBishop(square, blockers));
+    addAttacks(W_ROOK, hashRook(square, blockers));
+    addAttacks(W_QUEEN, hashRook(square, blockers) | hashBishop(square, blockers));
+    #undef addAttacks
+
+    return all | KING_TABLE[LSB(state->bb[colorPiece(W_KING, white)]) - 1];
+}
+
+double attackMapEval(const GameState *state) {
+    int wMobility, bMobility, wKingAttacks, bKingAttacks;
+    bitmask wPawns = state->bb[W_PAWN], bPawns = state->bb[B_PAWN],
+            wPawnAttacks, bPawnAttacks, wAttacks, bAttacks, wPieces, bPieces,
+            wKing = state->bb[W_KING], bKing = state->bb[B_KING];
+
+    wPieces = wPawns | state->bb[W_KNIGHT] | state->bb[W_BISHOP] |
+              state->bb[W_ROOK] | state->bb[W_QUEEN] | wKing;
+    bPieces = state->bb[BLOCKERS] & ~wPieces;
+    wPawnAttacks = (wPawns & ~FILE_A) << 7 | (wPawns & ~FILE_H) << 9;
+    bPawnAttacks = (bPawns & ~FILE_A) >> 9 | (bPawns & ~FILE_H) >> 7;
+
+    wAttacks = wPawnAttacks | sideAttacks(state, 1, wPieces | bPawnAttacks,
+        bKing | KING_TABLE[LSB(bKing) - 1], &wMobility, &wKingAttacks);
+    bAttacks = bPawnAttacks | sideAttacks(state, 0, bPieces | wPawnAttacks,
+        wKing | KING_TABLE[LSB(wKing) - 1], &bMobility, &bKingAttacks);
+
+    // Kings can't be captured, so they are never hanging
+    return state->material +
+        safeMobilityWeight * (wMobility - bMobility) +
+        kingAttackWeight * (wKingAttacks - bKingAttacks) +
+        hangingPieceWeight * (
+            POPCOUNT(bPieces & ~bKing & wAttacks & ~bAttacks) -
+            POPCOUNT(wPieces & ~wKing & bAttacks & ~wAttacks));
+}
+
+double pieceSquareEval(const GameState *state) {
+    // Promotions can take the phase past its starting value
+    int phase = state->phase < MAX_PHASE ? state->phase : MAX_PHASE;
+    return state->material + (state->pstMidgame * phase +
+        state->pstEndgame * (MAX_PHASE - phase)) / MAX_PHASE;
+}
+
+_Thread_local EvalCacheEntry evalCache[EVAL_CACHE_SIZE];
+_Thread_local unsigned long evalCacheHits, evalCacheMisses;
+
+// Number of entries in each thread's pawn hash table, a power of 2
+#define PAWN_HASH_SIZE (1 << 14)
+
+typedef struct PawnHashEntry {
+    bitmask pawnKey;
+    double score;
+} PawnHashEntry;
+
+/* Positions without pawns have a pawn key of 0, which matches the zeroed
+ * entries with the correct score of 0.
+ */
+static _Thread_local PawnHashEntry pawnHash[PAWN_HASH_SIZE];
+
+#define northFill(bm) ((bm) | (bm) << 8 | (bm) << 16 | (bm) << 24 | \
+                       (bm) << 32 | (bm) << 40 | (bm) << 48 | (bm) << 56)
+#define southFill(bm) ((bm) | (bm) >> 8 | (bm) >> 16 | (bm) >> 24 | \
+                       (bm) >> 32 | (bm) >> 40 | (bm) >> 48 | (bm) >> 56)
+#define besideFiles(bm) (((bm) & ~FILE_A) >> 1 | ((bm) & ~FILE_H) << 1)
+
+/**
+ * Private function.
+ * Scores one side's pawn structure, computed setwise.
+ * @param pawns - The side's pawns.
+ * @param enemyPawns - The other side's pawns.
+ * @param white - TRUE if the pawns are white. FALSE if black.
+ * @return The side's pawn structure score, positive if good for it.
+ */
+static double sidePawnScore(bitmask pawns, bitmask enemyPawns, int white) {
+    int rank;
+    double score = 0;
+    bitmask files, front, enemyFront, attacks, enemyAttacks, attackSpan,
+            passed, backward;
+
+    files = northFill(southFill(pawns));
+    if(white) {
+        front = northFill(pawns << 8);
+        enemyFront = southFill(enemyPawns >> 8);
+        attacks = (pawns & ~FILE_A) << 7 | (pawns & ~FILE_H) << 9;
+        enemyAttacks = (enemyPawns & ~FILE_A) >> 9 | (enemyPawns & ~FILE_H) >> 7;
+        attackSpan = northFill(attacks);
+        backward = (pawns << 8 & enemyAttacks & ~attackSpan) >> 8;
+    } else {
+        front = southFill(pawns >> 8);
+        enemyFront = northFill(enemyPawns << 8);
+        attacks = (pawns & ~FILE_A) >> 9 | (pawns & ~FILE_H) >> 7;
+        enemyAttacks = (enemyPawns & ~FILE_A) << 7 | (enemyPawns & ~FILE_H) << 9;
+        attackSpan = southFill(attacks);
+        backward = (pawns >> 8 & enemyAttacks & ~attackSpan) << 8;
+    }
+
+    // No enemy pawn ahead on the same or neighboring files
+    passed = pawns & ~(enemyFront | besideFiles(enemyFront));
+    for(; passed; passed &= passed - 1) {
+        rank = getRank(LSB(passed) - 1);
+        score += passedPawnWeight * (white ? rank - 1 : 6 - rank);
+    }
+    score -= isolatedPawnWeight * POPCOUNT(pawns & ~besideFiles(files));
+    score -= doubledPawnWeight * POPCOUNT(pawns & front);
+    score -= backwardPawnWeight * POPCOUNT(backward & pawns);
+    return score;
+}
+
+double pawnStructureScore(const GameState *state) {
+    PawnHashEntry *entry = &pawnHash[state->pawnKey & (PAWN_HASH_SIZE - 1)];
+    if(entry->pawnKey != state->pawnKey) {
+        entry->pawnKey = state->pawnKey;
+        entry->score =
+            sidePawnScore(state->bb[W_PAWN], state->bb[B_PAWN], 1) -
+            sidePawnScore(state->bb[B_PAWN], state->bb[W_PAWN], 0);
+    }
+    return entry->score;
+}
+
+double positionalEval(const GameState *state) {
+    int phase = state->phase < MAX_PHASE ? state->phase : MAX_PHASE;
+    bitmask wKing = state->bb[W_KING], bKing = state->bb[B_KING], wShield, bShield;
+
+    // The two squares in front of each king and beside them
+    wShield = wKing << 8 | wKing << 16;
+    wShield |= besideFiles(wShield);
+    bShield = bKing >> 8 | bKing >> 16;
+    bShield |= besideFiles(bShield);
+
+    return pieceSquareEval(state) + pawnStructureScore(state) +
+        pawnShieldWeight * phase / MAX_PHASE * (
+            POPCOUNT(state->bb[W_PAWN] & wShield) -
+            POPCOUNT(state->bb[B_PAWN] & bShield));
+}
+
+// The fewest positions worth giving a thread of its own in a batch
+#define MIN_BATCH_PER_THREAD 1024
+
+/* A contiguous slice of a batch of positions to evaluate, from start
+ * up to end. A batch is either of states, scored in centipawns, or of
+ * packed positions, scored in pawns.
+ */
+typedef struct BatchSlice {
+    const GameState *positions;
+    const PackedPosition *packed;
+    long start, end;
+    int *scoresOut;
+    double *pawnScoresOut;
+} BatchSlice;
+
+/**
+ * Private function.
+ * Evaluates a slice of a batch of states. Runs in its own thread.
+ * @param params - Pointer to the BatchSlice.
+ * @return NULL
+ */
+static void *evaluateSlice(void *params) {
+    const BatchSlice *slice = params;
+    long i;
+    for(i=slice->start; i<slice->end; i++) {
+        slice->scoresOut[i] = (int) (evaluationFunction(&slice->positions[i]) * 100);
+    }
+    return NULL;
+}
+
+/**
+ * Private function.
+ * Evaluates a slice of a batch of packed positions, unpacking each one
+ * as it goes. Runs in its own thread.
+ * @param params - Pointer to the BatchSlice.
+ * @return NULL
+ */
+static void *evaluatePackedSlice(void *params) {
+    const BatchSlice *slice = params;
+    GameState state;
+    long i;
+    for(i=slice->start; i<slice->end; i++) {
+        state = unpackPosition(&slice->packed[i]);
+        slice->pawnScoresOut[i] = evaluationFunction(&state);
+    }
+    return NULL;
+}
+
+/**
+ * Private function.
+ * Splits a batch into contiguous slices, one per thread, and evaluates
+ * them in new threads.
+ * @param batch - The batch, with its start and end ignored.
+ * @param n - The number of positions.
+ * @param work - The function evaluating a slice.
+ */
+static void runBatch(const BatchSlice *batch, long n, void *(*work)(void*)) {
+    long start, threads = n / MIN_BATCH_PER_THREAD;
+    int i;
+    pthread_t *workers;
+    BatchSlice *slices;
+
+    if(threads > numThreads) {
+        threads = numThreads;
+    }
+    if(threads < 1) {
+        threads = 1;
+    }
+
+    workers = malloc(threads * sizeof(pthread_t));
+    slices = malloc(threads * sizeof(BatchSlice));
+    errTrap(workers == NULL || slices == NULL,
+            "Error on malloc in runBatch\n");
+    for(i=start=0; i<threads; i++) {
+        slices[i] = *batch;
+        slices[i].start = start;
+        slices[i].end = start += n / threads + (i < n % threads);
+        errTrap(pthread_create(&workers[i], NULL, work, &slices[i]),
+                "Error on pthread_create in runBatch\n");
+    }
+    for(i=0; i<threads; i++) {
+        errTrap(pthread_join(workers[i], NULL),
+                "Error on pthread_join in runBatch\n");
+    }
+    free(workers);
+    free(slices);
+}
+
+void evaluateBatch(const GameState *positions, int n, int *scoresOut) {
+    BatchSlice batch = {0};
+    batch.positions = positions;
+    batch.scoresOut = scoresOut;
+    runBatch(&batch, n, evaluateSlice);
+}
+
+void evaluatePackedBatch(const PackedPosition *positions, long n, double *scoresOut) {
+    BatchSlice batch = {0};
+    batch.packed = positions;
+    batch.pawnScoresOut = scoresOut;
+    runBatch(&batch, n, evaluatePackedSlice);
+}
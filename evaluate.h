@@ -12,34 +12,155 @@
 #include "piece.h"
 #include "position.h"
 
+// The game phase with all the pieces on the board
+#define MAX_PHASE 24
+
+/* Piece-square tables, in pawns from white's perspective, indexed by
+ * piece and square. These are positional bonuses on top of the piece
+ * values. PHASE_WEIGHT is how much each piece adds to the game phase.
+ */
+extern double PST_MIDGAME[NUM_PIECES + 1][NUM_SQUARES],
+              PST_ENDGAME[NUM_PIECES + 1][NUM_SQUARES];
+extern const int PHASE_WEIGHT[NUM_PIECES + 1];
+
+/**
+ * This function should be called on program start to initialize
+ * the piece-square tables.
+ */
+void evaluateInit();
+
 /**
- * Sets the material score of the given state.
+ * Sets the material score of the given state, along with the
+ * piece-square table sums and the game phase.
  * @param state - Pointer to the current game state.
  */
 void setMaterialScore(GameState *state);
 
 /**
- * Returns a state's material count.
- * @param state - The current state of the board.
+ * Returns a state's material count. Defined here so that the
+ * search can inline it.
+ * @param state - Pointer to the current state of the board.
  * @return The state's material count.
  */
-double materialEval(GameState state);
+static inline double materialEval(const GameState *state) {
+    return state->material;
+}
 
 /**
  * Adds a small score for each pseudo-legal move each player can make.
  * Returns this plus the material value.
- * @param state - The current game state.
+ * @param state - Pointer to the current game state.
  * @return A score based on weighted piece values and influence.
  */
-double valueAndInfluence(GameState state);
+double valueAndInfluence(const GameState *state);
 
 /**
  * Adds a small score for each legal move each player could make
  * (if it were their turn to move).
  * Returns this plus the material value.
- * @param state - The current game state.
+ * @param state - Pointer to the current game state.
  * @return A score based on weighted piece values and mobility.
  */
-double valueAndMobility(GameState state);
+double valueAndMobility(const GameState *state);
+
+/**
+ * Builds each piece's attacks once from the attack tables and scores
+ * them with popcounts: safe mobility (squares not attacked by enemy
+ * pawns), attacks on the squares around the enemy king, and enemy pieces
+ * which are attacked but not defended.
+ * Returns this plus the material value.
+ * @param state - Pointer to the current game state.
+ * @return A score based on piece values and attack maps.
+ */
+double attackMapEval(const GameState *state);
+
+/**
+ * Blends the middlegame and endgame piece-square table sums by the game
+ * phase. Both sums and the phase are kept up to date by make-move, so
+ * this costs as little as materialEval.
+ * Returns this plus the material value.
+ * @param state - Pointer to the current game state.
+ * @return A score based on piece values and piece-square tables.
+ */
+double pieceSquareEval(const GameState *state);
+
+/**
+ * Scores the pawn structure from white's perspective: passed pawns by
+ * how far they have advanced, and isolated, doubled and backward pawns
+ * as penalties. The score depends only on the pawns, so it is cached in
+ * a table for the calling thread, keyed by the state's pawn key. A new
+ * thread starts with an empty table.
+ * @param state - Pointer to the current game state.
+ * @return The pawn structure score.
+ */
+double pawnStructureScore(const GameState *state);
+
+/**
+ * Adds the pawn structure and, weighted toward the middlegame, the pawns
+ * shielding each king to the tapered piece-square table evaluation.
+ * @param state - Pointer to the current game state.
+ * @return A score based on piece values, piece-square tables and pawns.
+ */
+double positionalEval(const GameState *state);
+
+/**
+ * Evaluates an array of positions with the selected evaluation function.
+ * Large batches are split across numThreads threads, each of which
+ * evaluates a contiguous slice. Every batch runs in new threads, so no
+ * score cached before an option changed is used.
+ * @param positions - The positions to evaluate.
+ * @param n - The number of positions.
+ * @param scoresOut - Output for each position's score, in centipawns
+ * from white's perspective.
+ */
+void evaluateBatch(const GameState *positions, int n, int *scoresOut);
+
+/**
+ * Evaluates an array of packed positions as evaluateBatch does, with
+ * each thread unpacking the positions of its slice as it evaluates them.
+ * The scores are not rounded, so they suit tuning.
+ * @param positions - The packed positions to evaluate.
+ * @param n - The number of positions.
+ * @param scoresOut - Output for each position's score, in pawns from
+ * white's perspective.
+ */
+void evaluatePackedBatch(const PackedPosition *positions, long n, double *scoresOut);
+
+// Number of entries in each thread's evaluation cache, a power of 2
+#define EVAL_CACHE_SIZE (1 << 16)
+
+typedef struct EvalCacheEntry {
+    bitmask key;
+    double score;
+} EvalCacheEntry;
+
+/* Static scores by position key, kept separately by each thread so that
+ * no locking is needed. A search runs in a new thread, so it starts with
+ * an empty cache and zeroed counters, and option changes between
+ * searches never see stale scores.
+ */
+extern _Thread_local EvalCacheEntry evalCache[EVAL_CACHE_SIZE];
+extern _Thread_local unsigned long evalCacheHits, evalCacheMisses;
+
+/**
+ * Returns the cached static score for the state's key, calling the
+ * evaluation function and storing its score on a miss. It is always
+ * inlined so that a constant evaluation function is called directly.
+ * @param state - Pointer to the current game state.
+ * @param evaluate - The evaluation function to cache.
+ * @return The static score of the state.
+ */
+ALWAYS_INLINE double cachedEval(const GameState *state,
+                                double (*evaluate)(const GameState*)) {
+    EvalCacheEntry *entry = &evalCache[state->key & (EVAL_CACHE_SIZE - 1)];
+    if(entry->key == state->key) {
+        evalCacheHits++;
+        return entry->score;
+    }
+    evalCacheMisses++;
+    entry->key = state->key;
+    entry->score = evaluate(state);
+    return entry->score;
+}
 
 #endif // EVALUATE_H_INCLUDED
@@ -0,0 +1,72 @@
+/**
+ * filemap.c contains implementation for the functions and constants
+ * defined in the associated header file.
+ * @author Blake Herrera
+ * @date 2023-04-30
+ * @see filemap.h
+ */
+
+#include "filemap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const void *mapFile(const char *szPath, size_t *size) {
+#ifdef _WIN32
+    FILE *file = fopen(szPath, "rb");
+    void *data = NULL;
+    long length;
+
+    *size = 0;
+    if(file == NULL) {
+        return NULL;
+    }
+    if(!fseek(file, 0, SEEK_END) && (length = ftell(file)) > 0 &&
+       !fseek(file, 0, SEEK_SET) && (data = malloc(length)) != NULL) {
+        if(fread(data, 1, length, file) == (size_t) length) {
+            *size = length;
+        } else {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+    return data;
+#else
+    struct stat info;
+    void *data;
+    int fd = open(szPath, O_RDONLY);
+
+    *size = 0;
+    if(fd == -1) {
+        return NULL;
+    }
+    if(fstat(fd, &info) || info.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping keeps the file open
+    if(data == MAP_FAILED) {
+        return NULL;
+    }
+    *size = info.st_size;
+    return data;
+#endif
+}
+
+void unmapFile(const void *data, size_t size) {
+#ifdef _WIN32
+    (void) size;
+    free((void*) data);
+#else
+    munmap((void*) data, size);
+#endif
+}
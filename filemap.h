@@ -0,0 +1,30 @@
+/**
+ * filemap.h contains functions for reading whole files through
+ * memory mapping, for the large data files used by tuning and training.
+ * Systems without mmap read the file into memory instead.
+ * @author Blake Herrera
+ * @date 2023-04-30
+ */
+
+#ifndef FILEMAP_H_INCLUDED
+#define FILEMAP_H_INCLUDED
+
+#include <stddef.h>
+
+/**
+ * Maps a file into memory, read only.
+ * @param szPath - The path of the file.
+ * @param size - Output for the size of the file in bytes.
+ * @return A pointer to the file's contents, or NULL if it could not be
+ * mapped or is empty.
+ */
+const void *mapFile(const char *szPath, size_t *size);
+
+/**
+ * Unmaps a file mapped by mapFile.
+ * @param data - The pointer returned by mapFile.
+ * @param size - The size of the file.
+ */
+void unmapFile(const void *data, size_t size);
+
+#endif // FILEMAP_H_INCLUDED
@@ -0,0 +1,211 @@
+/**
+ * gensfen.c contains implementation for the functions and constants
+ * defined in the associated header file.
+ * @author Blake Herrera
+ * @date 2023-05-01
+ * @see gensfen.h
+ */
+
+#include "gensfen.h"
+#include "bitboard.h"
+#include "config.h"
+#include "error.h"
+#include "move.h"
+#include "movegen.h"
+#include "position.h"
+#include "search.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Games reaching this many ply are adjudicated a draw
+#define MAX_GAME_PLY 400
+
+// The number of positions each thread collects before writing them
+#define WRITE_BATCH 4096
+
+// Scores are clipped to fit in a PackedPosition
+#define MAX_PACKED_SCORE 32000
+
+// Shared by every self-play thread, behind outputLock
+static FILE *outputFile;
+static pthread_mutex_t outputLock;
+static long positionsWanted, positionsWritten;
+static int writeFailed;
+
+// Read only while generating
+static int searchDepth, openingPlies;
+static long nodeLimit;
+
+/**
+ * Private function.
+ * Writes a thread's positions to the output file, unless enough have
+ * been written already.
+ * @param buffer - The positions to write.
+ * @param n - The number of positions.
+ * @return TRUE if more positions are wanted. FALSE otherwise.
+ */
+static int writePositions(const PackedPosition *buffer, int n) {
+    int more;
+    errTrap(pthread_mutex_lock(&outputLock),
+            "Error on pthread_mutex_lock in writePositions\n");
+    // Write no more than are wanted
+    if(n > positionsWanted - positionsWritten) {
+        n = positionsWanted - positionsWritten;
+    }
+    if(n > 0 && !writeFailed) {
+        if(fwrite(buffer, sizeof(PackedPosition), n, outputFile) != (size_t) n ||
+           fflush(outputFile)) {
+            writeFailed = 1;
+        } else {
+            positionsWritten += n;
+            printf("Wrote %ld positions\n", positionsWritten);
+            fflush(stdout);
+        }
+    }
+    more = positionsWritten < positionsWanted && !writeFailed;
+    errTrap(pthread_mutex_unlock(&outputLock),
+            "Error on pthread_mutex_unlock in writePositions\n");
+    return more;
+}
+
+/**
+ * Private function.
+ * Plays one self-play game, packing each searched position which isn't
+ * in check and doesn't have a mate score.
+ * @param thread - The search thread's own data.
+ * @param history - Space for the states of the game, MAX_GAME_PLY + 1.
+ * @param game - Output for the packed positions, at most MAX_GAME_PLY.
+ * @return The number of positions packed.
+ */
+static int playGame(SearchThread *thread, GameState *history, PackedPosition *game) {
+    int ply, depth, inCheck, i, n = 0, result;
+    unsigned long nodes;
+    const GameState *state;
+    moveScoreLeaves msl;
+    Move best;
+
+    // Random opening moves, starting over if the game ends during them
+    do {
+        history[0] = positionFromFen(START_FEN);
+        for(ply=0; ply<openingPlies && hasLegalMove(&history[ply]); ply++) {
+            history[ply + 1] = pushMove(&history[ply], getRandomMove(history[ply]));
+        }
+    } while(!hasLegalMove(&history[ply]));
+
+    for(;; ply++) {
+        state = &history[ply];
+        inCheck = getTurn(*state) ? wInCheck(state) : bInCheck(state);
+        if(!hasLegalMove(state)) {
+            result = inCheck ? (getTurn(*state) ? -1 : 1) : 0;
+            break;
+        }
+        // Bare kings can't mate
+        if(ply >= MAX_GAME_PLY || is50MoveRule(*state) || is3FoldRepetition(*state) ||
+           POPCOUNT(state->bb[BLOCKERS]) == 2) {
+            result = 0;
+            break;
+        }
+
+        /* Deepen until searchDepth, or until the iterations have searched
+         * nodeLimit leaves. The first iteration always runs, so msl is set.
+         */
+        initSearchThread(thread);
+        depth = 0;
+        nodes = 0;
+        do {
+            startIteration(thread);
+            msl = miniMax(thread, state, ++depth, 0, -INFINITY, INFINITY);
+            nodes += msl.leaves;
+        } while(depth < searchDepth && (nodeLimit == 0 || nodes < (unsigned long) nodeLimit));
+        best = thread->pvLength[0] ? thread->pv[0][0] : getRandomMove(*state);
+
+        if(!inCheck && !isMateScore(msl.score)) {
+            packPosition(state, &game[n]);
+            game[n++].score = (int16_t) fmax(-MAX_PACKED_SCORE,
+                                             fmin(MAX_PACKED_SCORE, msl.score * 100));
+        }
+        history[ply + 1] = pushMove(state, best);
+    }
+
+    for(i=0; i<n; i++) {
+        game[i].result = result;
+    }
+    return n;
+}
+
+/**
+ * Private function.
+ * Plays self-play games until enough positions have been written.
+ * Each thread running this has its own search data and game buffers.
+ * @param params - Unused.
+ * @return NULL
+ */
+static void *selfPlay(void *params) {
+    SearchThread *thread = malloc(sizeof(SearchThread));
+    GameState *history = malloc((MAX_GAME_PLY + 1) * sizeof(GameState));
+    PackedPosition *buffer = malloc((WRITE_BATCH + MAX_GAME_PLY) * sizeof(PackedPosition));
+    int n = 0, more = 1;
+
+    (void) params;
+    errTrap(thread == NULL || history == NULL || buffer == NULL,
+            "Error on malloc in selfPlay\n");
+    while(more) {
+        n += playGame(thread, history, buffer + n);
+        if(n >= WRITE_BATCH) {
+            more = writePositions(buffer, n);
+            n = 0;
+        } else {
+            more = writePositions(buffer, 0);
+        }
+    }
+    free(thread);
+    free(history);
+    free(buffer);
+    return NULL;
+}
+
+int generateTrainingData(const char *szOutputPath, long numPositions,
+                         int depth, long nodes, int randomPlies) {
+    int i, threads = numThreads < 1 ? 1 : numThreads,
+        savedStrategy = searchStrategy, savedPruning = pruning;
+    pthread_t *workers;
+
+    outputFile = fopen(szOutputPath, "ab");
+    if(outputFile == NULL) {
+        return 1;
+    }
+    positionsWanted = numPositions;
+    positionsWritten = 0;
+    writeFailed = 0;
+    searchDepth = depth < 1 ? 1 : depth;
+    nodeLimit = nodes < 0 ? 0 : nodes;
+    openingPlies = randomPlies;
+
+    // Scores are only worth training on from the full search
+    searchStrategy = PRODUCTION_STRATEGY;
+    pruning = PRODUCTION_PRUNING;
+    selectSearch();
+
+    workers = malloc(threads * sizeof(pthread_t));
+    errTrap(workers == NULL, "Error on malloc in generateTrainingData\n");
+    errTrap(pthread_mutex_init(&outputLock, NULL),
+            "Error on pthread_mutex_init in generateTrainingData\n");
+    for(i=0; i<threads; i++) {
+        errTrap(pthread_create(&workers[i], NULL, selfPlay, NULL),
+                "Error on pthread_create in generateTrainingData\n");
+    }
+    for(i=0; i<threads; i++) {
+        errTrap(pthread_join(workers[i], NULL),
+                "Error on pthread_join in generateTrainingData\n");
+    }
+    free(workers);
+    errTrap(pthread_mutex_destroy(&outputLock),
+            "Error on pthread_mutex_destroy in generateTrainingData\n");
+    searchStrategy = savedStrategy;
+    pruning = savedPruning;
+    selectSearch();
+    return fclose(outputFile) != 0 || writeFailed;
+}
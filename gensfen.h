@@ -0,0 +1,31 @@
+/**
+ * gensfen.h contains a generator of training data from self-play games.
+ * Each game starts with random moves from the starting position, then
+ * the engine plays both sides with a search limited by depth and by
+ * nodes, and the searched positions are written as PackedPositions with
+ * their search scores and the game's result. The production search
+ * strategy and pruning are used whatever the options are.
+ * @author Blake Herrera
+ * @date 2023-05-01
+ */
+
+#ifndef GENSFEN_H_INCLUDED
+#define GENSFEN_H_INCLUDED
+
+/**
+ * Plays self-play games on numThreads threads until the given number of
+ * positions have been written. Positions in check and those
+ * with a mate score are not written. Each thread writes its positions
+ * once it has collected a batch of them, so the file grows steadily.
+ * @param szOutputPath - The file to append the positions to.
+ * @param numPositions - The number of positions to generate.
+ * @param depth - The depth to search each position to.
+ * @param nodes - Each position's search stops deepening once it has
+ * searched this many leaves, or 0 for no limit.
+ * @param randomPlies - The number of random moves which start each game.
+ * @return 0 on success. Nonzero if the file could not be written.
+ */
+int generateTrainingData(const char *szOutputPath, long numPositions,
+                         int depth, long nodes, int randomPlies);
+
+#endif // GENSFEN_H_INCLUDED
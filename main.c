@@ -16,19 +16,66 @@
 #include "bitboard.h"
 #include "movegen.h"
 #include "evaluate.h"
+#include "search.h"
+#include "zobrist.h"
+#include "tune.h"
+#include "book.h"
+#include "bitbase.h"
+#include "gensfen.h"
 #include "debug.h"
 
+// The number of FENs read from stdin before evaluating them together
+#define FEN_BATCH_SIZE 65536
+
+/**
+ * Private function.
+ * Reads FENs from stdin, one per line, and prints the score of each,
+ * in centipawns from white's perspective, one per line in the same order.
+ * The move counters may be left off, and EPD operations are ignored.
+ */
+static void evaluateFens() {
+    static GameState positions[FEN_BATCH_SIZE];
+    static int scores[FEN_BATCH_SIZE];
+    char szLine[256];
+    int i, n, eof = 0;
+
+    while(!eof) {
+        for(n=0; n<FEN_BATCH_SIZE; ) {
+            if(fgets(szLine, sizeof(szLine), stdin) == NULL) {
+                eof = 1;
+                break;
+            }
+            if(positionFromFenLine(szLine, &positions[n])) {
+                n++;
+            } else if(szLine[strspn(szLine, " \r\n")] != '\0') {
+                fprintf(stderr, "Bad FEN: %s", szLine);
+            }
+        }
+        evaluateBatch(positions, n, scores);
+        for(i=0; i<n; i++) {
+            printf("%d\n", scores[i]);
+        }
+    }
+}
+
 int main(int argc, char **argv) {
-    int i;
+    int i, batchMode = 0, loadBitbases = 0;
+    const char *szTuneData = NULL, *szTuneOutput = "params.txt", *szTrainingData = NULL,
+               *szBitbaseDir = ".", *szBitbaseEndings = NULL, *szNnueFile = NULL,
+               *szBookFile = NULL;
+    long trainingPositions = 1000000, trainingNodes = 0;
+    int trainingDepth = 6, trainingRandomPlies = 8;
     const double defaultPieceValues[13] = {
         1, 3, 3, 5, 9, 999, -1, -3, -3, -5, -9, -999, 0
     };
-    double (*evaluationFuncs[NUM_EVALUATION_FUNCS])(GameState) = {
-        materialEval, valueAndInfluence, valueAndMobility
+    #define FUNCTION(index, function, suffix) [index] = function,
+    double (*evaluationFuncs[NUM_EVALUATION_FUNCS])(const GameState*) = {
+        EVALUATION_FUNCS(FUNCTION)
     };
+    #undef FUNCTION
 
-    searchStrategy = MINIMAX;
-    pruning = AB_PRUNING;
+    searchStrategy = PRODUCTION_STRATEGY;
+    pruning = PRODUCTION_PRUNING;
     evaluation = MATERIAL_EVAL;
     evaluationFunction = materialEval;
     forwardPruneN = 999;
@@ -36,8 +83,22 @@ int main(int argc, char **argv) {
     maxSearchDepth = 99;
     mobilityFactor = 0.1;
     timeUseFraction = 0.05;
-    quiescenceCutoff = 1.0;
-    quiescenceMaxDepth = 3;
+    deltaMargin = 2.0;
+    futilityMargin = 1.0;
+    reverseFutilityMargin = 0.8;
+    razorMargin = 3.0;
+    lazyEvalMargin = 4.0;
+    safeMobilityWeight = 0.05;
+    kingAttackWeight = 0.1;
+    hangingPieceWeight = 0.3;
+    passedPawnWeight = 0.1;
+    isolatedPawnWeight = 0.15;
+    doubledPawnWeight = 0.15;
+    backwardPawnWeight = 0.1;
+    pawnShieldWeight = 0.1;
+    quiescenceMaxDepth = 10;
+    nullMoveVerifyDepth = 12;
+    ownBook = 0;
     for(i=0; i<NUM_PIECES+1; i++) {
         pieceValues[i] = defaultPieceValues[i];
     }
@@ -53,18 +114,8 @@ int main(int argc, char **argv) {
             pruning = atoi(argv[++i]);
         } else if(is("-evaluation")) {
             evaluation = atoi(argv[++i]);
-            switch(evaluation) {
-            case MATERIAL_EVAL:
-                evaluationFunction = materialEval;
-                break;
-            case MATERIAL_AND_INFLUENCE:
-                evaluationFunction = valueAndInfluence;
-                break;
-            case MATERIAL_AND_MOBILITY:
-                evaluationFunction = valueAndMobility;
-                break;
-            default:
-                break;
+            if(evaluation >= 0 && evaluation < NUM_EVALUATION_FUNCS) {
+                evaluationFunction = evaluationFuncs[evaluation];
             }
         } else if(is("-forwardPruneN")) {
             forwardPruneN = atoi(argv[++i]);
@@ -76,10 +127,67 @@ int main(int argc, char **argv) {
             mobilityFactor = atof(argv[++i]);
         } else if(is("-timeUseFraction")) {
             timeUseFraction = atof(argv[++i]);
-        } else if(is("-quiescenceCutoff")) {
-            quiescenceCutoff = atof(argv[++i]);
+        } else if(is("-deltaMargin")) {
+            deltaMargin = atof(argv[++i]);
+        } else if(is("-futilityMargin")) {
+            futilityMargin = atof(argv[++i]);
+        } else if(is("-reverseFutilityMargin")) {
+            reverseFutilityMargin = atof(argv[++i]);
+        } else if(is("-razorMargin")) {
+            razorMargin = atof(argv[++i]);
+        } else if(is("-lazyEvalMargin")) {
+            lazyEvalMargin = atof(argv[++i]);
+        } else if(is("-safeMobilityWeight")) {
+            safeMobilityWeight = atof(argv[++i]);
+        } else if(is("-kingAttackWeight")) {
+            kingAttackWeight = atof(argv[++i]);
+        } else if(is("-hangingPieceWeight")) {
+            hangingPieceWeight = atof(argv[++i]);
+        } else if(is("-passedPawnWeight")) {
+            passedPawnWeight = atof(argv[++i]);
+        } else if(is("-isolatedPawnWeight")) {
+            isolatedPawnWeight = atof(argv[++i]);
+        } else if(is("-doubledPawnWeight")) {
+            doubledPawnWeight = atof(argv[++i]);
+        } else if(is("-backwardPawnWeight")) {
+            backwardPawnWeight = atof(argv[++i]);
+        } else if(is("-pawnShieldWeight")) {
+            pawnShieldWeight = atof(argv[++i]);
         } else if(is("-quiescenceMaxDepth")) {
             quiescenceMaxDepth = atoi(argv[++i]);
+        } else if(is("-nullMoveVerifyDepth")) {
+            nullMoveVerifyDepth = atoi(argv[++i]);
+        } else if(is("-nnueFile")) {
+            szNnueFile = argv[++i];
+        } else if(is("-ownBook")) {
+            ownBook = atoi(argv[++i]);
+        } else if(is("-bookFile")) {
+            szBookFile = argv[++i];
+        } else if(is("-bitbaseDir")) {
+            szBitbaseDir = argv[++i];
+            loadBitbases = 1;
+        } else if(is("-buildBitbases")) {
+            szBitbaseEndings = argv[++i];
+        } else if(is("-evaluateFens")) {
+            batchMode = 1;
+        } else if(is("-tune")) {
+            szTuneData = argv[++i];
+        } else if(is("-tuneOutput")) {
+            szTuneOutput = argv[++i];
+        } else if(is("-gensfen")) {
+            szTrainingData = argv[++i];
+        } else if(is("-gensfenPositions")) {
+            trainingPositions = atol(argv[++i]);
+        } else if(is("-gensfenDepth")) {
+            trainingDepth = atoi(argv[++i]);
+        } else if(is("-gensfenNodes")) {
+            trainingNodes = atol(argv[++i]);
+        } else if(is("-gensfenRandomPlies")) {
+            trainingRandomPlies = atoi(argv[++i]);
+        } else if(is("-paramFile")) {
+            if(loadParameters(argv[++i])) {
+                fprintf(stderr, "Could not load parameters %s\n", argv[i]);
+            }
         } else if(is("-pieceValues")) {
 
         } else {
@@ -91,8 +199,40 @@ int main(int argc, char **argv) {
     srand(clock());
     bitboardInit();
     movegenInit();
+    evaluateInit();
+    zobristInit();
+    searchInit();
     //findMagics();
 
+    // Files named on the command line are loaded once the tables are set up
+    if(szNnueFile != NULL && nnueLoad(szNnueFile)) {
+        fprintf(stderr, "Could not load network %s\n", szNnueFile);
+    }
+    if(szBookFile != NULL && bookLoad(szBookFile)) {
+        fprintf(stderr, "Could not load book %s\n", szBookFile);
+    }
+    if(loadBitbases && bitbaseLoad(szBitbaseDir) == 0) {
+        fprintf(stderr, "No bitbases in %s\n", szBitbaseDir);
+    }
+
+    if(batchMode) {
+        evaluateFens();
+        return 0;
+    }
+    if(szTuneData != NULL) {
+        return tune(szTuneData, szTuneOutput);
+    }
+    if(szBitbaseEndings != NULL) {
+        return buildBitbases(szBitbaseDir, szBitbaseEndings);
+    }
+    if(szTrainingData != NULL) {
+        if(generateTrainingData(szTrainingData, trainingPositions, trainingDepth,
+                                trainingNodes, trainingRandomPlies)) {
+            fprintf(stderr, "Could not write training data to %s\n", szTrainingData);
+            return 1;
+        }
+        return 0;
+    }
     uciCommunicate();
     return 0;
 }
@@ -7,8 +7,10 @@
  */
 
 #include "move.h"
+#include "movegen.h"
 #include "piece.h"
 #include "config.h"
+#include "zobrist.h"
 
 #include <math.h>
 #include <stdio.h>
@@ -22,119 +24,157 @@ void toLAN(Move m, char *szBuffer) {
     szBuffer[5] = '\0';
 }
 
-GameState pushMove(GameState *state, Move m) {
-    return pushMoveVerbose(state, getSource(m), getDestination(m),
-        getMovedPiece(m), getCapturedPiece(m), isEP(m), isCastling(m),
-        isPromotion(m) ? getPromotionPiece(m) : NUM_PIECES);
-}
-
-GameState pushMoveVerbose(GameState *state, Square source, Square destination,
-        int movedPiece, int capturedPiece, int isEP, int isCastling, int promotion) {
+/**
+ * Private function.
+ * Makes a move for one side. It is always inlined with a constant color,
+ * so each side gets a copy with its pieces and pawn direction fixed at
+ * compile time. The parameters match pushMoveVerbose.
+ * @param white - TRUE if white is moving. FALSE if black is.
+ * @return The next game state.
+ */
+ALWAYS_INLINE GameState makeColorMove(const GameState *state, Square source,
+        Square destination, int movedPiece, int capturedPiece, int isEP,
+        int isCastling, int promotion, const int white) {
     GameState nextState = *state;
-    if(source == destination) {
-        // null move
-        setTurn(nextState, !getTurn(nextState));
-        nextState.prev = state;
-        setHasEPTarget(nextState, 0);
-        setHalfMoveCounter(nextState, getHalfMoveCounter(nextState) + 1);
-        setFullMoveCounter(nextState,
-            getFullMoveCounter(nextState) + getTurn(nextState));
-        return nextState;
-    }
-
-    // Remove source piece, place source piece
-    nextState.bb[movedPiece] ^=
-        1ULL << source | 1ULL << destination;
-    nextState.bb[BLOCKERS] ^= 1ULL << source;
+    const int up = white ? 8 : -8, recordDirty = evaluation == NNUE_EVAL;
+    int rook = colorPiece(W_ROOK, white), capturedSquare, rookSource, rookDestination;
+    bitmask fromTo = 1ULL << source | 1ULL << destination, captured;
+
+    /* Moves a piece in the piece-square sums and the key, and records it
+     * as dirty for the network. A piece passed as NUM_PIECES has no key,
+     * so pass it as the destination piece to take a piece off the board.
+     * Only the network reads dirty pieces, so they are left unknown for
+     * the other evaluations.
+     */
+    #define movePiece(piece, from, to, toPiece) \
+        nextState.pstMidgame += PST_MIDGAME[toPiece][to] - PST_MIDGAME[piece][from]; \
+        nextState.pstEndgame += PST_ENDGAME[toPiece][to] - PST_ENDGAME[piece][from]; \
+        nextState.key ^= ZOBRIST_PIECES[piece][from] ^ ZOBRIST_PIECES[toPiece][to]; \
+        if(recordDirty) { \
+            nextState.dirty[nextState.numDirty++] = (DirtyPiece) {piece, from, to, toPiece}; \
+        }
+    nextState.numDirty = recordDirty ? 0 : UNKNOWN_DIRTY;
 
+    // Move the piece, replacing it if it promotes
+    nextState.bb[movedPiece] ^= fromTo;
+    nextState.bb[BLOCKERS] ^= fromTo;
     if(promotion != NUM_PIECES) {
         nextState.bb[movedPiece] ^= 1ULL << destination;
         nextState.bb[promotion] ^= 1ULL << destination;
         nextState.material += pieceValues[promotion] - pieceValues[movedPiece];
+        nextState.phase += PHASE_WEIGHT[promotion];
+        movePiece(movedPiece, source, destination, promotion);
+    } else {
+        movePiece(movedPiece, source, destination, movedPiece);
+    }
+    if(movedPiece == colorPiece(W_PAWN, white)) {
+        nextState.pawnKey ^= ZOBRIST_PIECES[movedPiece][source] ^
+            ZOBRIST_PIECES[promotion == NUM_PIECES ? movedPiece : NUM_PIECES][destination];
     }
 
-    // Remove captured piece + check for EP
-    nextState.bb[capturedPiece] &= ~(1ULL << destination);
-    nextState.bb[BLOCKERS] |= 1ULL << destination;
-    if(isEP) {
-        nextState.bb[capturedPiece] &= ~(1ULL << (destination + 8 + getTurn(*state) * -16));
-        nextState.bb[BLOCKERS] &= ~(1ULL << (destination + 8 + getTurn(*state) * -16));
+    /* Remove the captured piece, which is behind the destination for EP.
+     * Toggling the blockers again refills the destination otherwise.
+     */
+    if(capturedPiece != NUM_PIECES) {
+        capturedSquare = isEP ? destination - up : destination;
+        captured = 1ULL << capturedSquare;
+        nextState.bb[capturedPiece] ^= captured;
+        nextState.bb[BLOCKERS] ^= captured;
+        // Incrementally update material count
+        nextState.material -= pieceValues[capturedPiece];
+        nextState.phase -= PHASE_WEIGHT[capturedPiece];
+        movePiece(capturedPiece, capturedSquare, capturedSquare, NUM_PIECES);
+        if(capturedPiece == colorPiece(W_PAWN, !white)) {
+            nextState.pawnKey ^= ZOBRIST_PIECES[capturedPiece][capturedSquare];
+        }
     }
-    // Incrementally update material count
-    nextState.material -= pieceValues[capturedPiece];
 
     // Check for castling, move rook
     if(isCastling) {
-        switch(destination) {
-        case C1:
-            nextState.bb[W_ROOK] ^= (1ULL << A1) | (1ULL << D1);
-            nextState.bb[BLOCKERS] ^= (1ULL << A1) | (1ULL << D1);
-            break;
-        case G1:
-            nextState.bb[W_ROOK] ^= (1ULL << H1) | (1ULL << F1);
-            nextState.bb[BLOCKERS] ^= (1ULL << H1) | (1ULL << F1);
-            break;
-        case C8:
-            nextState.bb[B_ROOK] ^= (1ULL << A8) | (1ULL << D8);
-            nextState.bb[BLOCKERS] ^= (1ULL << A8) | (1ULL << D8);
-            break;
-        case G8:
-            nextState.bb[B_ROOK] ^= (1ULL << H8) | (1ULL << F8);
-            nextState.bb[BLOCKERS] ^= (1ULL << H8) | (1ULL << F8);
-            break;
-        }
+        nextState.bb[rook] ^= CASTLING_ROOK_MOVES[destination];
+        nextState.bb[BLOCKERS] ^= CASTLING_ROOK_MOVES[destination];
+        // The rook crosses to the square the king passed over
+        rookSource = destination < source ? destination - 2 : destination + 1;
+        rookDestination = (source + destination) / 2;
+        movePiece(rook, rookSource, rookDestination, rook);
     }
+    #undef movePiece
 
     // Update turn, prev state, full move counter
-    setTurn(nextState, !getTurn(nextState));
+    setTurn(nextState, !white);
     nextState.prev = state;
     setFullMoveCounter(nextState,
-        getFullMoveCounter(nextState) + getTurn(nextState));
+        getFullMoveCounter(nextState) + !white);
 
     // Update castling rights
-    if(movedPiece == W_KING || source == A1 || destination == A1) {
-        setWCanCastleQ(nextState, 0);
-    }
-    if(movedPiece == W_KING || source == H1 || destination == H1) {
-        setWCanCastleK(nextState, 0);
-    }
-    if(movedPiece == B_KING || source == A8 || destination == A8) {
-        setBCanCastleQ(nextState, 0);
-    }
-    if(movedPiece == B_KING || source == H8 || destination == H8) {
-        setBCanCastleK(nextState, 0);
-    }
+    nextState.fenInfo &= CASTLING_RIGHTS_MASK[source] & CASTLING_RIGHTS_MASK[destination];
+    nextState.key ^= ZOBRIST_TURN ^
+        ZOBRIST_CASTLING[getCastlingRights(*state)] ^
+        ZOBRIST_CASTLING[getCastlingRights(nextState)];
 
     // Update EP target
-    if(movedPiece == W_PAWN && destination - source == 16) {
-        setEPTarget(nextState, source + 8);
-    } else if(movedPiece == B_PAWN && destination - source == -16) {
-        setEPTarget(nextState, source - 8);
+    if(hasEPTarget(*state)) {
+        nextState.key ^= ZOBRIST_EP[getFile(getEPTarget(*state))];
+    }
+    if(movedPiece == colorPiece(W_PAWN, white) && destination - source == 2 * up) {
+        setEPTarget(nextState, source + up);
+        nextState.key ^= ZOBRIST_EP[getFile(source)];
     } else {
         setHasEPTarget(nextState, 0);
     }
 
     // Update half move counter
     setHalfMoveCounter(nextState,
-        movedPiece == W_PAWN ||
-        movedPiece == B_PAWN ||
+        movedPiece == colorPiece(W_PAWN, white) ||
         capturedPiece != NUM_PIECES ?
         0 : getHalfMoveCounter(nextState) + 1);
 
     return nextState;
 }
 
-GameState pushLAN(GameState *state, const char *szLAN) {
+GameState pushMove(const GameState *state, Move m) {
+    return pushMoveVerbose(state, getSource(m), getDestination(m),
+        getMovedPiece(m), getCapturedPiece(m), isEP(m), isCastling(m),
+        isPromotion(m) ? getPromotionPiece(m) : NUM_PIECES);
+}
+
+GameState pushMoveVerbose(const GameState *state, Square source, Square destination,
+        int movedPiece, int capturedPiece, int isEP, int isCastling, int promotion) {
+    GameState nextState;
+    if(source == destination) {
+        // null move
+        nextState = *state;
+        setTurn(nextState, !getTurn(nextState));
+        nextState.prev = state;
+        nextState.numDirty = 0;
+        nextState.key ^= ZOBRIST_TURN;
+        if(hasEPTarget(nextState)) {
+            nextState.key ^= ZOBRIST_EP[getFile(getEPTarget(nextState))];
+        }
+        setHasEPTarget(nextState, 0);
+        setHalfMoveCounter(nextState, getHalfMoveCounter(nextState) + 1);
+        setFullMoveCounter(nextState,
+            getFullMoveCounter(nextState) + getTurn(nextState));
+        return nextState;
+    }
+    return getTurn(*state) ?
+        makeColorMove(state, source, destination, movedPiece, capturedPiece,
+                      isEP, isCastling, promotion, 1) :
+        makeColorMove(state, source, destination, movedPiece, capturedPiece,
+                      isEP, isCastling, promotion, 0);
+}
+
+GameState pushLAN(const GameState *state, const char *szLAN) {
     Square source, destination;
     int movedPiece, capturedPiece, isEP, castling, promotion;
 
     source = szLAN[0] - 'a' + 8 * (szLAN[1] - '1');
     destination = szLAN[2] - 'a' + 8 * (szLAN[3] - '1');
-    movedPiece = getPieceFromSquare(*state, source);
+    movedPiece = getPieceFromSquare(state, source);
     isEP = hasEPTarget(*state) && destination == getEPTarget(*state) && (
             movedPiece == W_PAWN || movedPiece == B_PAWN);
     capturedPiece = isEP ? W_PAWN + 6 * getTurn(*state) :
-        getPieceFromSquare(*state, destination);
+        getPieceFromSquare(state, destination);
     castling = (movedPiece == W_KING || movedPiece == B_KING) &&
             abs(source - destination) == 2;
     promotion = szLAN[4] == '\0' ? NUM_PIECES :
@@ -34,6 +34,10 @@
     ((move) >> 19 & 0b1111)
 #define getCapturedPiece(move) \
     ((move) >> 23 & 0b1111)
+#define isCapture(move) \
+    (getCapturedPiece(move) != NUM_PIECES)
+#define isQuiet(move) \
+    (!isCapture(move) && !isPromotion(move))
 
 #define setSource(move, square) \
     move = (move & ~63) | (square)
@@ -79,7 +83,7 @@ void toLAN(Move m, char *szBuffer);
  * @param m - The move to push.
  * @return The next game state.
  */
-GameState pushMove(GameState *state, Move m);
+GameState pushMove(const GameState *state, Move m);
 
 /**
  * Pushes a move onto the current board, and returns a new board.
@@ -95,7 +99,7 @@ GameState pushMove(GameState *state, Move m);
  * NUM_PIECES / BLOCKERS (12) if no promotion.
  * @return The next game state.
  */
-GameState pushMoveVerbose(GameState *state, Square source, Square destination,
+GameState pushMoveVerbose(const GameState *state, Square source, Square destination,
     int movedPiece, int capturedPiece, int isEP, int isCastling, int promotion);
 
 /**
@@ -104,6 +108,6 @@ GameState pushMoveVerbose(GameState *state, Square source, Square destination,
  * @param szLAN - Pointer to the Long Algebraic Notation string.
  * @return The next game state.
  */
-GameState pushLAN(GameState *state, const char *szLAN);
+GameState pushLAN(const GameState *state, const char *szLAN);
 
 #endif // MOVE_H_INCLUDED
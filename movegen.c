@@ -28,9 +28,49 @@ bitmask BISHOP_RELEVANT_OCCUPANCY[NUM_SQUARES],
 int ROOK_BITS[NUM_SQUARES],
     BISHOP_BITS[NUM_SQUARES];
 
+bitmask CASTLING_ROOK_MOVES[NUM_SQUARES];
+int CASTLING_RIGHTS_MASK[NUM_SQUARES];
+
+bitmask BETWEEN[NUM_SQUARES][NUM_SQUARES],
+        LINE[NUM_SQUARES][NUM_SQUARES];
+
 void movegenInit() {
-    int i;
+    int i, direction, target;
     bitmask pos;
+    GameState rights;
+
+    // Opposite directions are 4 apart, see bitboard.h
+    for(i=0; i<NUM_SQUARES; i++) {
+        for(direction=0; direction<8; direction++) {
+            for(pos = RAYS[direction][i]; pos; pos &= pos - 1) {
+                target = LSB(pos) - 1;
+                BETWEEN[i][target] =
+                    RAYS[direction][i] & RAYS[(direction + 4) % 8][target];
+                LINE[i][target] = SQUARES[i] |
+                    RAYS[direction][i] | RAYS[(direction + 4) % 8][i];
+            }
+        }
+    }
+
+    CASTLING_ROOK_MOVES[C1] = SQUARES[A1] | SQUARES[D1];
+    CASTLING_ROOK_MOVES[G1] = SQUARES[H1] | SQUARES[F1];
+    CASTLING_ROOK_MOVES[C8] = SQUARES[A8] | SQUARES[D8];
+    CASTLING_ROOK_MOVES[G8] = SQUARES[H8] | SQUARES[F8];
+
+    #define clearRights(square, clear) \
+        rights.fenInfo = ~0; \
+        clear; \
+        CASTLING_RIGHTS_MASK[square] = rights.fenInfo
+    for(i=0; i<NUM_SQUARES; i++) {
+        CASTLING_RIGHTS_MASK[i] = ~0;
+    }
+    clearRights(A1, setWCanCastleQ(rights, 0));
+    clearRights(H1, setWCanCastleK(rights, 0));
+    clearRights(E1, setWCanCastleK(rights, 0); setWCanCastleQ(rights, 0));
+    clearRights(A8, setBCanCastleQ(rights, 0));
+    clearRights(H8, setBCanCastleK(rights, 0));
+    clearRights(E8, setBCanCastleK(rights, 0); setBCanCastleQ(rights, 0));
+    #undef clearRights
 
     // The edge of the ray is not a blocker
     for(i=0; i<NUM_SQUARES; i++) {
@@ -78,7 +118,7 @@ void movegenInit() {
             shiftDown(shiftRight(pos, 1), 1);
         PAWN_TABLE[1][i] =
             shiftUp(shiftLeft(pos, 1), 1) |
-            shiftUp(shiftLeft(pos, 1), 1);
+            shiftUp(shiftRight(pos, 1), 1);
 
         // Queen moves calculated from rook and bishop
     }
@@ -172,13 +212,30 @@ bitmask _calculateBishopMoves(Square square, bitmask blockers) {
     return attacks;
 }
 
-void generatePseudoLegalMoves(GameState *state, Move moveBuffer[MAX_MOVES], int *numMoves) {
-    int i=0, j, turn, squareSource, squareDestination;
-    bitmask movesMask, piecesMask, blockers, bmSource, bmDestination;
+/**
+ * Private function.
+ * Generates the pseudo-legal moves of one side. It is always inlined with
+ * a constant color, so each side gets a copy with its piece indices, pawn
+ * direction and promotion rank fixed at compile time.
+ * @param state - Pointer to the current state.
+ * @param moveBuffer - Output buffer for the moves.
+ * @param white - TRUE to generate white's moves. FALSE for black's.
+ * @return The number of moves generated.
+ */
+ALWAYS_INLINE int generateColorMoves(const GameState *state, Move moveBuffer[MAX_MOVES],
+                                     const int white) {
+    int i=0, j, squareSource, squareDestination;
+    bitmask movesMask, piecesMask, blockers, bmSource, bmDestination, epMask,
+            pawns, singlePushes, doublePushes, leftCaptures, rightCaptures;
     Move nextMove;
+    const int up = white ? 8 : -8;
+    const bitmask pushRank = white ? RANK_3 : RANK_6,  // After one push
+                  promotionRank = white ? RANK_8 : RANK_1;
 
     blockers = state->bb[BLOCKERS];
-    turn = getTurn(*state);
+    epMask = hasEPTarget(*state) ? 1ULL << getEPTarget(*state) : NO_SQUARES;
+
+    #define own(piece) colorPiece(piece, white)
 
     #define repeat(piece) \
         movesMask = 0ULL; \
@@ -203,226 +260,370 @@ void generatePseudoLegalMoves(GameState *state, Move moveBuffer[MAX_MOVES], int
         } \
         setCapturedPiece(nextMove, j)
 
-    if(turn) {  // White's turn
-        /* Pawn moves generated first to facilitate promotions
-         * This is a hacky workaround for piece-square tables
-         */
-        repeat(W_PAWN) {
-            squareSource = LSB(piecesMask) - 1;
-            bmSource = 1ULL << squareSource;
-            squareDestination = squareSource + 8;
-            bmDestination = 1ULL << squareDestination;
-            if(!(blockers & bmDestination)) {
-                movesMask |= bmDestination;
-                if(bmSource & RANK_2 && !(blockers & (bmDestination << 8))) {
-                    movesMask |= bmDestination << 8;
-                    // TODO set next EP target square in move?
-                }
-            }
-            if(getFile(squareSource) != 7 &&
-               (blockers & (bmDestination << 1) || (hasEPTarget(*state) &&
-               squareDestination + 1 == getEPTarget(*state)))) {
-                movesMask |= bmDestination << 1;
-            }
-            if(getFile(squareSource) != 0 &&
-               (blockers & (bmDestination >> 1) || (hasEPTarget(*state) &&
-               squareDestination - 1 == getEPTarget(*state)))) {
-                movesMask |= bmDestination >> 1;
-            }
+    // Shifts toward the side's promotion rank
+    #define pawnShift(bm, n) (white ? (bm) << (n) : (bm) >> (n))
 
-            nextMove = squareSource;
-            setMovedPiece(nextMove, W_PAWN);
-            for(; movesMask; movesMask &= ~bmDestination) {
-                squareDestination = LSB(movesMask) - 1;
-                bmDestination = 1ULL << squareDestination;
-                setDestination(nextMove, squareDestination);
-                setIsEP(nextMove, hasEPTarget(*state) && getEPTarget(*state) == squareDestination);
-                setCapturedPieceType(bmDestination);
-                if(isEP(nextMove)) {
-                    setCapturedPiece(nextMove, B_PAWN);
-                }
-                if(bmSource & RANK_7) {
-                    setIsPromotion(nextMove, 1);
-                    for(j=W_KNIGHT; j<=W_QUEEN; j++) {
-                        setPromotionPiece(nextMove, j);
-                        moveBuffer[i++] = nextMove;
-                    }
-                    setIsPromotion(nextMove, 0);
-                } else {
-                    moveBuffer[i++] = nextMove;
-                }
-            }
+    #define addPawnMoves(targets, offset, capture) \
+        for(movesMask = (targets); movesMask; movesMask &= movesMask - 1) { \
+            squareDestination = LSB(movesMask) - 1; \
+            bmDestination = 1ULL << squareDestination; \
+            nextMove = squareDestination - (offset); \
+            setMovedPiece(nextMove, own(W_PAWN)); \
+            setDestination(nextMove, squareDestination); \
+            if(!(capture)) { \
+                setCapturedPiece(nextMove, NUM_PIECES); \
+            } else if(bmDestination == epMask) { \
+                setIsEP(nextMove, 1); \
+                setCapturedPiece(nextMove, colorPiece(W_PAWN, !white)); \
+            } else { \
+                setCapturedPieceType(bmDestination); \
+            } \
+            if(bmDestination & promotionRank) { \
+                setIsPromotion(nextMove, 1); \
+                for(j=own(W_KNIGHT); j<=own(W_QUEEN); j++) { \
+                    setPromotionPiece(nextMove, j); \
+                    moveBuffer[i++] = nextMove; \
+                } \
+            } else { \
+                moveBuffer[i++] = nextMove; \
+            } \
         }
 
-        repeat(W_KING) {
-            squareSource = LSB(piecesMask) - 1;
-            bmSource = 1ULL << squareSource;
-            movesMask = KING_TABLE[squareSource];
-            setNextMoves(W_KING);
-
-            setCapturedPiece(nextMove, NUM_PIECES);  // No capture
-            if(squareSource == E1) {
-                setIsCastling(nextMove, 1);
-                if(!(W_CASTLE_K & blockers) && wCanCastleK(*state)) {
-                    setDestination(nextMove, G1);
-                    moveBuffer[i++] = nextMove;
-                }
-                if(!(W_CASTLE_Q & blockers) && wCanCastleQ(*state)) {
-                    setDestination(nextMove, C1);
-                    moveBuffer[i++] = nextMove;
-                }
-                setIsCastling(nextMove, 0);
-            }
-        }
-    } else {
-        /* Pawn moves generated first to facilitate promotions
-         * This is a hacky workaround for piece-square tables
-         */
-        repeat(B_PAWN) {
-            squareSource = LSB(piecesMask) - 1;
-            bmSource = 1ULL << squareSource;
-            squareDestination = squareSource - 8;
-            bmDestination = 1ULL << squareDestination;
-            if(!(blockers & bmDestination)) {
-                movesMask |= bmDestination;
-                if(bmSource & RANK_7 && !(blockers & (bmDestination >> 8))) {
-                    movesMask |= bmDestination >> 8;
-                    // TODO set next EP target square in move?
-                }
-            }
-            if(getFile(squareSource) != 7 &&
-               (blockers & bmDestination << 1 || (hasEPTarget(*state) &&
-               squareDestination + 1 == getEPTarget(*state)))) {
-                movesMask |= bmDestination << 1;
+    /* Pawn moves generated first to facilitate promotions
+     * This is a hacky workaround for piece-square tables
+     * Every pawn moves at once: each target set is shifted from the
+     * pawns, so the source is the destination less a fixed offset.
+     * Diagonals go onto any piece (own pieces are filtered as illegal)
+     * or the EP target.
+     */
+    pawns = state->bb[own(W_PAWN)];
+    singlePushes = pawnShift(pawns, 8) & ~blockers;
+    doublePushes = pawnShift(singlePushes & pushRank, 8) & ~blockers;
+    leftCaptures = pawnShift(pawns & ~FILE_A, white ? 7 : 9) & (blockers | epMask);
+    rightCaptures = pawnShift(pawns & ~FILE_H, white ? 9 : 7) & (blockers | epMask);
+    addPawnMoves(singlePushes, up, 0);
+    addPawnMoves(doublePushes, 2 * up, 0);
+    addPawnMoves(leftCaptures, white ? 7 : -9, 1);
+    addPawnMoves(rightCaptures, white ? 9 : -7, 1);
+
+    repeat(own(W_KING)) {
+        squareSource = LSB(piecesMask) - 1;
+        bmSource = 1ULL << squareSource;
+        movesMask = KING_TABLE[squareSource];
+        setNextMoves(own(W_KING));
+
+        setCapturedPiece(nextMove, NUM_PIECES);  // No capture
+        if(squareSource == (white ? E1 : E8)) {
+            setIsCastling(nextMove, 1);
+            if(!((white ? W_CASTLE_K : B_CASTLE_K) & blockers) &&
+               (white ? wCanCastleK(*state) : bCanCastleK(*state))) {
+                setDestination(nextMove, white ? G1 : G8);
+                moveBuffer[i++] = nextMove;
             }
-            if(getFile(squareSource) != 0 &&
-               (blockers & bmDestination >> 1 || (hasEPTarget(*state) &&
-               squareDestination - 1 == getEPTarget(*state)))) {
-                movesMask |= bmDestination >> 1;
-            }
-
-            nextMove = squareSource;
-            setMovedPiece(nextMove, B_PAWN);
-            for(; movesMask; movesMask &= ~bmDestination) {
-                squareDestination = LSB(movesMask) - 1;
-                bmDestination = 1ULL << squareDestination;
-                setDestination(nextMove, squareDestination);
-                setIsEP(nextMove, hasEPTarget(*state) && getEPTarget(*state) == squareDestination);
-                setCapturedPieceType(bmDestination);
-                if(isEP(nextMove)) {
-                    setCapturedPiece(nextMove, W_PAWN);
-                }
-                if(bmSource & RANK_2) {
-                    setIsPromotion(nextMove, 1);
-                    for(j=B_KNIGHT; j<=B_QUEEN; j++) {
-                        setPromotionPiece(nextMove, j);
-                        moveBuffer[i++] = nextMove;
-                    }
-                    setIsPromotion(nextMove, 0);
-                } else {
-                    moveBuffer[i++] = nextMove;
-                }
-            }
-        }
-
-        repeat(B_KING) {
-            squareSource = LSB(piecesMask) - 1;
-            bmSource = 1ULL << squareSource;
-            movesMask = KING_TABLE[squareSource];
-            setNextMoves(B_KING);
-            if(squareSource == E8) {
-                setIsCastling(nextMove, 1);
-                if(!(B_CASTLE_K & blockers) && bCanCastleK(*state)) {
-                    setDestination(nextMove, G8);
-                    setCapturedPiece(nextMove, NUM_PIECES);
-                    moveBuffer[i++] = nextMove;
-                }
-                if(!(B_CASTLE_Q & blockers) && bCanCastleQ(*state)) {
-                    setDestination(nextMove, C8);
-                    setCapturedPiece(nextMove, NUM_PIECES);
-                    moveBuffer[i++] = nextMove;
-                }
-                setIsCastling(nextMove, 0);
+            if(!((white ? W_CASTLE_Q : B_CASTLE_Q) & blockers) &&
+               (white ? wCanCastleQ(*state) : bCanCastleQ(*state))) {
+                setDestination(nextMove, white ? C1 : C8);
+                moveBuffer[i++] = nextMove;
             }
+            setIsCastling(nextMove, 0);
         }
     }
 
-    repeat(B_ROOK - NUM_PIECES / 2 * turn) {
+    repeat(own(W_ROOK)) {
         squareSource = LSB(piecesMask) - 1;
         bmSource = 1ULL << squareSource;
         movesMask = hashRook(squareSource, blockers);
-        setNextMoves(B_ROOK - NUM_PIECES / 2 * turn);
+        setNextMoves(own(W_ROOK));
     }
 
-    repeat(B_KNIGHT - NUM_PIECES / 2 * turn) {
+    repeat(own(W_KNIGHT)) {
         squareSource = LSB(piecesMask) - 1;
         bmSource = 1ULL << squareSource;
         movesMask = KNIGHT_TABLE[squareSource];
-        setNextMoves(B_KNIGHT - NUM_PIECES / 2 * turn);
+        setNextMoves(own(W_KNIGHT));
     }
 
-    repeat(B_BISHOP - NUM_PIECES / 2 * turn) {
+    repeat(own(W_BISHOP)) {
         squareSource = LSB(piecesMask) - 1;
         bmSource = 1ULL << squareSource;
         movesMask = hashBishop(squareSource, blockers);
-        setNextMoves(B_BISHOP - NUM_PIECES / 2 * turn);
+        setNextMoves(own(W_BISHOP));
     }
 
-    repeat(B_QUEEN - NUM_PIECES / 2 * turn) {
+    repeat(own(W_QUEEN)) {
         squareSource = LSB(piecesMask) - 1;
         bmSource = 1ULL << squareSource;
         movesMask = hashRook(squareSource, blockers);
         movesMask |= hashBishop(squareSource, blockers);
-        setNextMoves(B_QUEEN - NUM_PIECES / 2 * turn);
+        setNextMoves(own(W_QUEEN));
     }
 
+    #undef own
     #undef repeat
     #undef setNextMoves
     #undef setCapturedPieceType
+    #undef pawnShift
+    #undef addPawnMoves
+
+    return i;
+}
 
-    *numMoves = i;
+void generatePseudoLegalMoves(const GameState *state, Move moveBuffer[MAX_MOVES], int *numMoves) {
+    *numMoves = getTurn(*state) ?
+        generateColorMoves(state, moveBuffer, 1) :
+        generateColorMoves(state, moveBuffer, 0);
 }
 
-void generateLegalMoves(GameState *state, Move moveBuffer[MAX_MOVES], int *numMoves) {
-    int i, n, m;
+/**
+ * Private function.
+ * Counts the moves the given pawns could make onto the target squares,
+ * counting each promotion four times. The parameters match those of
+ * countColorLegalMoves, which it is inlined into.
+ * @param pawns - The pawns to move.
+ * @param blockers - The occupied squares.
+ * @param captures - The squares the pawns may capture on.
+ * @param targets - The squares the pawns may move to.
+ * @param white - TRUE if the pawns are white. FALSE if black.
+ * @return The number of pawn moves.
+ */
+ALWAYS_INLINE int countPawnMoves(bitmask pawns, bitmask blockers, bitmask captures,
+                                 bitmask targets, const int white) {
+    bitmask singlePushes, doublePushes, leftCaptures, rightCaptures;
+    const bitmask pushRank = white ? RANK_3 : RANK_6,
+                  promotionRank = white ? RANK_8 : RANK_1;
+
+    #define pawnShift(bm, n) (white ? (bm) << (n) : (bm) >> (n))
+    #define countPromotions(bm) \
+        (POPCOUNT((bm) & ~promotionRank) + 4 * POPCOUNT((bm) & promotionRank))
+
+    singlePushes = pawnShift(pawns, 8) & ~blockers;
+    doublePushes = pawnShift(singlePushes & pushRank, 8) & ~blockers;
+    leftCaptures = pawnShift(pawns & ~FILE_A, white ? 7 : 9) & captures;
+    rightCaptures = pawnShift(pawns & ~FILE_H, white ? 9 : 7) & captures;
+    return POPCOUNT(doublePushes & targets) +
+        countPromotions(singlePushes & targets) +
+        countPromotions(leftCaptures & targets) +
+        countPromotions(rightCaptures & targets);
+
+    #undef pawnShift
+    #undef countPromotions
+}
+
+/**
+ * Private function.
+ * Counts the pseudo-legal moves of one side. It is always inlined with
+ * a constant color, like generateColorMoves, whose moves it counts.
+ * @param state - Pointer to the current state.
+ * @param white - TRUE to count white's moves. FALSE for black's.
+ * @return The number of pseudo-legal moves.
+ */
+ALWAYS_INLINE int countColorPseudoLegalMoves(const GameState *state, const int white) {
+    int n, square;
+    bitmask bm, blockers = state->bb[BLOCKERS], epMask = NO_SQUARES;
+
+    #define own(piece) colorPiece(piece, white)
+
+    if(hasEPTarget(*state) && getTurn(*state) == white) {
+        epMask = 1ULL << getEPTarget(*state);
+    }
+    // Diagonals onto any piece, as generated
+    n = countPawnMoves(state->bb[own(W_PAWN)], blockers, blockers | epMask,
+                       ALL_SQUARES, white);
+
+    for(bm = state->bb[own(W_KING)]; bm; bm &= bm - 1) {
+        square = LSB(bm) - 1;
+        n += POPCOUNT(KING_TABLE[square]);
+        if(square == (white ? E1 : E8)) {
+            n += !((white ? W_CASTLE_K : B_CASTLE_K) & blockers) &&
+                 (white ? wCanCastleK(*state) : bCanCastleK(*state));
+            n += !((white ? W_CASTLE_Q : B_CASTLE_Q) & blockers) &&
+                 (white ? wCanCastleQ(*state) : bCanCastleQ(*state));
+        }
+    }
+    for(bm = state->bb[own(W_KNIGHT)]; bm; bm &= bm - 1) {
+        n += POPCOUNT(KNIGHT_TABLE[LSB(bm) - 1]);
+    }
+    for(bm = state->bb[own(W_BISHOP)] | state->bb[own(W_QUEEN)]; bm; bm &= bm - 1) {
+        n += POPCOUNT(hashBishop(LSB(bm) - 1, blockers));
+    }
+    for(bm = state->bb[own(W_ROOK)] | state->bb[own(W_QUEEN)]; bm; bm &= bm - 1) {
+        n += POPCOUNT(hashRook(LSB(bm) - 1, blockers));
+    }
+
+    #undef own
+
+    return n;
+}
+
+int countPseudoLegalMoves(const GameState *state, int white) {
+    return white ?
+        countColorPseudoLegalMoves(state, 1) :
+        countColorPseudoLegalMoves(state, 0);
+}
+
+/**
+ * Private function.
+ * Counts the legal moves of one side. It is always inlined with a
+ * constant color. The king may step to any square the enemy doesn't
+ * attack, looking through the king along enemy rays. In check, other
+ * pieces must capture a single checker or block it. Pinned pieces must
+ * stay on the line through the king and the pinning piece. En passant
+ * is rare and can uncover the king along a rank, so it is tested by
+ * making the move.
+ * @param state - Pointer to the current state.
+ * @param white - TRUE to count white's moves. FALSE for black's.
+ * @return The number of legal moves.
+ */
+ALWAYS_INLINE int countColorLegalMoves(const GameState *state, const int white) {
+    int n, king, square;
+    bitmask bm, moves, ownPieces, enemyPieces, blockers, attacked, checkers, targets,
+            snipers, pinned;
     GameState nextState;
-    generatePseudoLegalMoves(state, moveBuffer, &n);
-    for(i=0; i<n; i++) {
-        m = moveBuffer[i];
-        if(getMovedPiece(m) / 6 == getCapturedPiece(m) / 6) {
-            // Same color capture
-            moveBuffer[i--] = moveBuffer[--n];
-            continue;
+
+    #define own(piece) colorPiece(piece, white)
+    #define enemy(piece) colorPiece(piece, !white)
+
+    blockers = state->bb[BLOCKERS];
+    ownPieces = state->bb[own(W_PAWN)] | state->bb[own(W_KNIGHT)] | state->bb[own(W_BISHOP)] |
+                state->bb[own(W_ROOK)] | state->bb[own(W_QUEEN)] | state->bb[own(W_KING)];
+    enemyPieces = blockers & ~ownPieces;
+    king = LSB(state->bb[own(W_KING)]) - 1;
+    attacked = getAttacksWithOccupancy(state, !white, blockers & ~state->bb[own(W_KING)]);
+    checkers = getAttackersTo(state, king, blockers) & enemyPieces;
+
+    n = POPCOUNT(KING_TABLE[king] & ~ownPieces & ~attacked);
+    if(checkers & (checkers - 1)) {
+        return n;  // Double check, only the king can move
+    }
+
+    if(checkers) {
+        targets = (checkers | BETWEEN[king][LSB(checkers) - 1]) & ~ownPieces;
+    } else {
+        targets = ~ownPieces;
+        // Castling out of or through check was ruled out above
+        if(king == (white ? E1 : E8)) {
+            n += !((white ? W_CASTLE_K : B_CASTLE_K) & blockers) &&
+                 !((white ? W_CASTLE_K : B_CASTLE_K) & attacked) &&
+                 (white ? wCanCastleK(*state) : bCanCastleK(*state));
+            n += !((white ? W_CASTLE_Q : B_CASTLE_Q) & blockers) &&
+                 !((white ? SQUARES[C1] | SQUARES[D1] : SQUARES[C8] | SQUARES[D8]) & attacked) &&
+                 (white ? wCanCastleQ(*state) : bCanCastleQ(*state));
+        }
+    }
+
+    // A lone piece between the king and an enemy slider is pinned
+    snipers = (hashRook(king, NO_SQUARES) &
+               (state->bb[enemy(W_ROOK)] | state->bb[enemy(W_QUEEN)])) |
+              (hashBishop(king, NO_SQUARES) &
+               (state->bb[enemy(W_BISHOP)] | state->bb[enemy(W_QUEEN)]));
+    pinned = NO_SQUARES;
+    for(; snipers; snipers &= snipers - 1) {
+        bm = BETWEEN[king][LSB(snipers) - 1] & blockers;
+        if(!(bm & (bm - 1))) {
+            pinned |= bm & ownPieces;
         }
-        if(isCastling(m)) {
-            #define test(sq1, sq2, func1, func2) \
-                case sq1: \
-                    if(func1(*state, sq2) || func2(*state)) { \
-                        moveBuffer[i--] = moveBuffer[--n]; \
-                        continue; \
-                    } \
-                    break;
-            // No castling out of or through check
-            switch(getDestination(m)) {
-            test(C1, D1, bAttacks, wInCheck);
-            test(G1, F1, bAttacks, wInCheck);
-            test(C8, D8, wAttacks, bInCheck);
-            test(G8, F8, wAttacks, bInCheck);
-            default:
+    }
+
+    bm = state->bb[own(W_PAWN)];
+    n += countPawnMoves(bm & ~pinned, blockers, enemyPieces, targets, white);
+    for(bm &= pinned; bm; bm &= bm - 1) {
+        square = LSB(bm) - 1;
+        n += countPawnMoves(SQUARES[square], blockers, enemyPieces,
+                            targets & LINE[king][square], white);
+    }
+    if(hasEPTarget(*state) && getTurn(*state) == white) {
+        square = getEPTarget(*state);
+        for(bm = PAWN_TABLE[!white][square] & state->bb[own(W_PAWN)]; bm; bm &= bm - 1) {
+            nextState = pushMoveVerbose(state, LSB(bm) - 1, square, own(W_PAWN),
+                                        enemy(W_PAWN), 1, 0, NUM_PIECES);
+            n += white ? !wInCheck(&nextState) : !bInCheck(&nextState);
+        }
+    }
+
+    // Pinned knights can never move
+    for(bm = state->bb[own(W_KNIGHT)] & ~pinned; bm; bm &= bm - 1) {
+        n += POPCOUNT(KNIGHT_TABLE[LSB(bm) - 1] & targets);
+    }
+    for(bm = state->bb[own(W_BISHOP)] | state->bb[own(W_QUEEN)]; bm; bm &= bm - 1) {
+        square = LSB(bm) - 1;
+        moves = hashBishop(square, blockers) & targets;
+        n += POPCOUNT(SQUARES[square] & pinned ? moves & LINE[king][square] : moves);
+    }
+    for(bm = state->bb[own(W_ROOK)] | state->bb[own(W_QUEEN)]; bm; bm &= bm - 1) {
+        square = LSB(bm) - 1;
+        moves = hashRook(square, blockers) & targets;
+        n += POPCOUNT(SQUARES[square] & pinned ? moves & LINE[king][square] : moves);
+    }
+
+    #undef own
+    #undef enemy
+
+    return n;
+}
+
+int countLegalMoves(const GameState *state, int white) {
+    return white ?
+        countColorLegalMoves(state, 1) :
+        countColorLegalMoves(state, 0);
+}
+
+/**
+ * Private function.
+ * Checks whether a pseudo-legal move is legal.
+ * @param state - Pointer to the current state.
+ * @param m - The pseudo-legal move to check.
+ * @return TRUE if the move is legal. FALSE otherwise.
+ */
+static int isLegalMove(const GameState *state, Move m) {
+    GameState nextState;
+    if(getMovedPiece(m) / 6 == getCapturedPiece(m) / 6) {
+        // Same color capture
+        return 0;
+    }
+    if(isCastling(m)) {
+        #define test(sq1, sq2, func1, func2) \
+            case sq1: \
+                if(func1(state, sq2) || func2(state)) { \
+                    return 0; \
+                } \
                 break;
-            }
-            #undef test
+        // No castling out of or through check
+        switch(getDestination(m)) {
+        test(C1, D1, bAttacks, wInCheck);
+        test(G1, F1, bAttacks, wInCheck);
+        test(C8, D8, wAttacks, bInCheck);
+        test(G8, F8, wAttacks, bInCheck);
+        default:
+            break;
         }
+        #undef test
+    }
 
-        nextState = pushMove(state, m);
+    nextState = pushMove(state, m);
 
-        if((getTurn(nextState) && bInCheck(nextState)) ||
-           (!getTurn(nextState) && wInCheck(nextState))) {
-            // player put self in check
+    // player put self in check
+    return getTurn(nextState) ? !bInCheck(&nextState) : !wInCheck(&nextState);
+}
+
+void generateLegalMoves(const GameState *state, Move moveBuffer[MAX_MOVES], int *numMoves) {
+    int i, n;
+    generatePseudoLegalMoves(state, moveBuffer, &n);
+    for(i=0; i<n; i++) {
+        if(!isLegalMove(state, moveBuffer[i])) {
             moveBuffer[i--] = moveBuffer[--n];
-            continue;
         }
     }
     *numMoves = n;
 }
 
+int hasLegalMove(const GameState *state) {
+    int i, n;
+    Move moveBuffer[MAX_MOVES];
+    generatePseudoLegalMoves(state, moveBuffer, &n);
+    for(i=0; i<n; i++) {
+        if(isLegalMove(state, moveBuffer[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
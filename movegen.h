@@ -37,6 +37,22 @@ extern bitmask BISHOP_RELEVANT_OCCUPANCY[NUM_SQUARES],
 extern int ROOK_BITS[NUM_SQUARES],
            BISHOP_BITS[NUM_SQUARES];
 
+/* Used by make-move. CASTLING_ROOK_MOVES is indexed by the king's
+ * destination when castling and holds the rook's source and destination.
+ * CASTLING_RIGHTS_MASK is ANDed into fenInfo for both squares of any move,
+ * clearing the rights lost when a king or rook leaves its starting square
+ * or a rook is captured there.
+ */
+extern bitmask CASTLING_ROOK_MOVES[NUM_SQUARES];
+extern int CASTLING_RIGHTS_MASK[NUM_SQUARES];
+
+/* For two squares on a shared rank, file or diagonal, BETWEEN holds the
+ * squares strictly between them and LINE holds the whole line through
+ * both, edge to edge. Both are empty for unaligned squares.
+ */
+extern bitmask BETWEEN[NUM_SQUARES][NUM_SQUARES],
+               LINE[NUM_SQUARES][NUM_SQUARES];
+
 /**
  * This function should be called on program start to initialize
  * the arrays for the magic bitboards. This should be called after
@@ -94,7 +110,7 @@ bitmask _calculateBishopMoves(Square square, bitmask blockers);
  * @param moveBuffer - Output buffer array for the list of moves.
  * @param numMoves - Output variable for the number of moves generated.
  */
-void generatePseudoLegalMoves(GameState *state, Move moveBuffer[MAX_MOVES], int *numMoves);
+void generatePseudoLegalMoves(const GameState *state, Move moveBuffer[MAX_MOVES], int *numMoves);
 
 /**
  * This function generates legal moves from a given position.
@@ -102,7 +118,38 @@ void generatePseudoLegalMoves(GameState *state, Move moveBuffer[MAX_MOVES], int
  * @param moveBuffer - Output buffer array for the list of moves.
  * @param numMoves - Output variable for the number of moves generated.
  */
-void generateLegalMoves(GameState *state, Move moveBuffer[MAX_MOVES], int *numMoves);
+void generateLegalMoves(const GameState *state, Move moveBuffer[MAX_MOVES], int *numMoves);
+
+/**
+ * Counts the pseudo-legal moves one side could make if it were its turn,
+ * without writing a move list. When white is the side to move, this is
+ * the number generatePseudoLegalMoves would generate. En passant is only
+ * counted for the side to move.
+ * @param state - Pointer to the current state.
+ * @param white - TRUE to count white's moves. FALSE for black's.
+ * @return The number of pseudo-legal moves.
+ */
+int countPseudoLegalMoves(const GameState *state, int white);
+
+/**
+ * Counts the legal moves one side could make if it were its turn,
+ * without writing a move list. Moves are counted from destination masks
+ * restricted by checks and pins. En passant is only counted for the side
+ * to move.
+ * @param state - Pointer to the current state.
+ * @param white - TRUE to count white's moves. FALSE for black's.
+ * @return The number of legal moves.
+ */
+int countLegalMoves(const GameState *state, int white);
+
+/**
+ * This function checks whether the side to move has any legal move,
+ * stopping at the first one found. This is cheaper than generating
+ * every legal move when only checkmate or stalemate matters.
+ * @param state - Pointer to the current state.
+ * @return TRUE if there is a legal move. FALSE otherwise.
+ */
+int hasLegalMove(const GameState *state);
 
 /**
  * This function plays a move on a game state, and returns the new state.
@@ -111,6 +158,6 @@ void generateLegalMoves(GameState *state, Move moveBuffer[MAX_MOVES], int *numMo
  * @param m - The move to play.
  * @return A new state with the move played.
  */
-GameState pushMove(GameState *state, Move m);
+GameState pushMove(const GameState *state, Move m);
 
 #endif // MOVEGEN_H_INCLUDED
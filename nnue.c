@@ -0,0 +1,240 @@
+/**
+ * nnue.c contains implementation for the functions and constants
+ * defined in the associated header file.
+ * @author Blake Herrera
+ * @date 2023-04-29
+ * @see nnue.h
+ */
+
+#include "nnue.h"
+#include "bitboard.h"
+#include "evaluate.h"
+#include "piece.h"
+#include "position.h"
+#include "square.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Number of accumulators kept by each thread, a power of 2
+#define NNUE_ACCUMULATORS (1 << 11)
+
+/* The most states to walk back through to find a built accumulator
+ * before building one from scratch instead.
+ */
+#define MAX_LAZY_UPDATES 8
+
+/* The last row of input weights is all 0, for no piece, so that a
+ * dirty piece taken off the board needs no special case.
+ */
+static _Alignas(32) int16_t INPUT_WEIGHTS[NNUE_INPUTS + 1][NNUE_HIDDEN],
+                            HIDDEN_BIASES[NNUE_HIDDEN],
+                            OUTPUT_WEIGHTS[2][NNUE_HIDDEN];
+static int16_t OUTPUT_BIAS;
+static int networkLoaded = 0;
+
+// The hidden layer of a position, from white's then black's perspective
+typedef struct Accumulator {
+    _Alignas(32) int16_t values[2][NNUE_HIDDEN];
+    bitmask key;
+} Accumulator;
+
+/* A search runs in a new thread, so a network loaded between searches
+ * never sees accumulators built from the last one.
+ */
+static _Thread_local Accumulator accumulators[NNUE_ACCUMULATORS];
+
+int nnueLoad(const char *szPath) {
+    FILE *file = fopen(szPath, "rb");
+    if(file == NULL) {
+        networkLoaded = 0;
+        return 1;
+    }
+    networkLoaded =
+        fread(INPUT_WEIGHTS, sizeof(int16_t), NNUE_INPUTS * NNUE_HIDDEN, file) ==
+            NNUE_INPUTS * NNUE_HIDDEN &&
+        fread(HIDDEN_BIASES, sizeof(int16_t), NNUE_HIDDEN, file) == NNUE_HIDDEN &&
+        fread(OUTPUT_WEIGHTS, sizeof(int16_t), 2 * NNUE_HIDDEN, file) == 2 * NNUE_HIDDEN &&
+        fread(&OUTPUT_BIAS, sizeof(int16_t), 1, file) == 1;
+    fclose(file);
+    return !networkLoaded;
+}
+
+/**
+ * Private function.
+ * Gets the input weights for a piece on a square from one perspective.
+ * @param perspective - 0 for white's perspective. 1 for black's.
+ * @param piece - The piece, or NUM_PIECES for none.
+ * @param square - The square the piece is on.
+ * @return The row of input weights.
+ */
+static inline const int16_t *inputRow(int perspective, int piece, int square) {
+    if(piece == NUM_PIECES) {
+        return INPUT_WEIGHTS[NNUE_INPUTS];
+    }
+    if(perspective) {
+        piece = (piece + NUM_PIECES / 2) % NUM_PIECES;
+        square ^= 56;
+    }
+    return INPUT_WEIGHTS[piece * NUM_SQUARES + square];
+}
+
+/**
+ * Private function.
+ * Adds one row of input weights to a hidden layer and subtracts another.
+ * @param values - The hidden layer to update.
+ * @param add - The row to add.
+ * @param sub - The row to subtract.
+ */
+static inline void updateHidden(int16_t *values, const int16_t *add, const int16_t *sub) {
+    int i;
+#if defined(__AVX2__)
+    for(i=0; i<NNUE_HIDDEN; i+=16) {
+        __m256i v = _mm256_load_si256((const __m256i*) (values + i));
+        v = _mm256_add_epi16(v, _mm256_load_si256((const __m256i*) (add + i)));
+        v = _mm256_sub_epi16(v, _mm256_load_si256((const __m256i*) (sub + i)));
+        _mm256_store_si256((__m256i*) (values + i), v);
+    }
+#elif defined(__SSE2__)
+    for(i=0; i<NNUE_HIDDEN; i+=8) {
+        __m128i v = _mm_load_si128((const __m128i*) (values + i));
+        v = _mm_add_epi16(v, _mm_load_si128((const __m128i*) (add + i)));
+        v = _mm_sub_epi16(v, _mm_load_si128((const __m128i*) (sub + i)));
+        _mm_store_si128((__m128i*) (values + i), v);
+    }
+#else
+    for(i=0; i<NNUE_HIDDEN; i++) {
+        values[i] += add[i] - sub[i];
+    }
+#endif
+}
+
+/**
+ * Private function.
+ * Sums one half of the hidden layer, clipped to [0, NNUE_QA], times its
+ * output weights.
+ * @param values - The half of the hidden layer.
+ * @param weights - The output weights for that half.
+ * @return The weighted sum.
+ */
+static inline int32_t outputSum(const int16_t *values, const int16_t *weights) {
+    int i;
+    int32_t sum = 0;
+#if defined(__AVX2__)
+    __m256i zero = _mm256_setzero_si256(), qa = _mm256_set1_epi16(NNUE_QA),
+            total = _mm256_setzero_si256();
+    __m128i half;
+    for(i=0; i<NNUE_HIDDEN; i+=16) {
+        __m256i v = _mm256_load_si256((const __m256i*) (values + i));
+        v = _mm256_min_epi16(_mm256_max_epi16(v, zero), qa);
+        total = _mm256_add_epi32(total, _mm256_madd_epi16(v,
+            _mm256_load_si256((const __m256i*) (weights + i))));
+    }
+    half = _mm_add_epi32(_mm256_castsi256_si128(total), _mm256_extracti128_si256(total, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    sum = _mm_cvtsi128_si32(half);
+#elif defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128(), qa = _mm_set1_epi16(NNUE_QA),
+            total = _mm_setzero_si128();
+    for(i=0; i<NNUE_HIDDEN; i+=8) {
+        __m128i v = _mm_load_si128((const __m128i*) (values + i));
+        v = _mm_min_epi16(_mm_max_epi16(v, zero), qa);
+        total = _mm_add_epi32(total, _mm_madd_epi16(v,
+            _mm_load_si128((const __m128i*) (weights + i))));
+    }
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0x4E));
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0xB1));
+    sum = _mm_cvtsi128_si32(total);
+#else
+    for(i=0; i<NNUE_HIDDEN; i++) {
+        int16_t v = values[i] < 0 ? 0 : values[i] > NNUE_QA ? NNUE_QA : values[i];
+        sum += (int32_t) v * weights[i];
+    }
+#endif
+    return sum;
+}
+
+/**
+ * Private function.
+ * Builds a position's hidden layer from scratch.
+ * @param state - Pointer to the game state.
+ * @param values - Output for the hidden layer from both perspectives.
+ */
+static void buildHidden(const GameState *state, int16_t values[2][NNUE_HIDDEN]) {
+    int perspective, piece;
+    bitmask bm;
+    for(perspective=0; perspective<2; perspective++) {
+        memcpy(values[perspective], HIDDEN_BIASES, sizeof(HIDDEN_BIASES));
+        for(piece=0; piece<NUM_PIECES; piece++) {
+            for(bm=state->bb[piece]; bm; bm&=bm-1) {
+                updateHidden(values[perspective],
+                    inputRow(perspective, piece, LSB(bm) - 1),
+                    INPUT_WEIGHTS[NNUE_INPUTS]);
+            }
+        }
+    }
+}
+
+/**
+ * Private function.
+ * Gets a position's accumulator, building it from the previous state's
+ * if that can be found within MAX_LAZY_UPDATES states, or from scratch.
+ * A state whose previous state is itself has been overwritten by its
+ * next state, so its dirty pieces can't be used. Nor can those of a state
+ * made while another evaluation was selected, which weren't recorded.
+ * @param state - Pointer to the game state.
+ * @param depth - The number of states walked back so far.
+ * @return The position's accumulator.
+ */
+static const Accumulator *getAccumulator(const GameState *state, int depth) {
+    Accumulator *entry = &accumulators[state->key & (NNUE_ACCUMULATORS - 1)];
+    const Accumulator *prev;
+    const DirtyPiece *dirty;
+    int i, perspective;
+
+    if(entry->key == state->key) {
+        return entry;
+    }
+    if(state->prev != NULL && state->prev != state && state->numDirty != UNKNOWN_DIRTY &&
+       depth < MAX_LAZY_UPDATES) {
+        // The previous state's accumulator may have been built in this entry
+        prev = getAccumulator(state->prev, depth + 1);
+        if(prev != entry) {
+            memcpy(entry->values, prev->values, sizeof(entry->values));
+        }
+        for(i=0; i<state->numDirty; i++) {
+            dirty = &state->dirty[i];
+            for(perspective=0; perspective<2; perspective++) {
+                updateHidden(entry->values[perspective],
+                    inputRow(perspective, dirty->toPiece, dirty->to),
+                    inputRow(perspective, dirty->piece, dirty->from));
+            }
+        }
+    } else {
+        buildHidden(state, entry->values);
+    }
+    entry->key = state->key;
+    return entry;
+}
+
+double nnueEval(const GameState *state) {
+    const Accumulator *accumulator;
+    int us;
+    double score;
+
+    if(!networkLoaded) {
+        return pieceSquareEval(state);
+    }
+    accumulator = getAccumulator(state, 0);
+    us = !getTurn(*state);
+    score = (double) (outputSum(accumulator->values[us], OUTPUT_WEIGHTS[0]) +
+                      outputSum(accumulator->values[!us], OUTPUT_WEIGHTS[1]) +
+                      OUTPUT_BIAS) * NNUE_SCALE / (NNUE_QA * NNUE_QB) / 100;
+    return us ? -score : score;
+}
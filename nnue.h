@@ -0,0 +1,59 @@
+/**
+ * nnue.h contains an efficiently updatable neural network evaluation.
+ * The network has 768 inputs, one for each piece on each square, which
+ * feed a hidden layer of NNUE_HIDDEN neurons once from white's
+ * perspective and once from black's (with the board flipped and the
+ * colors swapped). The two halves, side to move first, are clipped to
+ * [0, NNUE_QA] and summed into a single output.
+ *
+ * The hidden layer values, the accumulator, only change by a few rows of
+ * weights per move, so each is built from the previous state's using the
+ * dirty pieces recorded by make-move. Accumulators are kept by position
+ * key in a table for the calling thread, and only built when a position
+ * is evaluated.
+ *
+ * The kernels use AVX2 or SSE2 when the compiler targets them
+ * (for example with -march=native), and plain C otherwise.
+ * @author Blake Herrera
+ * @date 2023-04-29
+ * @see https://www.chessprogramming.org/NNUE
+ */
+
+#ifndef NNUE_H_INCLUDED
+#define NNUE_H_INCLUDED
+
+#include "position.h"
+
+#define NNUE_INPUTS 768
+#define NNUE_HIDDEN 64
+
+/* The network is quantized to 16 bit integers. The hidden layer is
+ * scaled by NNUE_QA and the output weights by NNUE_QB, and the output
+ * is multiplied by NNUE_SCALE to get centipawns.
+ */
+#define NNUE_QA 255
+#define NNUE_QB 64
+#define NNUE_SCALE 400
+
+/**
+ * Loads the network's weights from a file of little endian 16 bit
+ * integers, in order: the input weights, NNUE_HIDDEN for each input
+ * (white pawns a1 to h8, then knights, bishops, rooks, queens and king,
+ * then black's pieces in the same order), the NNUE_HIDDEN hidden biases,
+ * the output weights for the side to move's half then the other half,
+ * and the output bias. Searches started afterward use the new network.
+ * @param szPath - The path of the network file.
+ * @return 0 on success. Nonzero if the file could not be read, in which
+ * case no network is loaded.
+ */
+int nnueLoad(const char *szPath);
+
+/**
+ * Evaluates a position with the network, from white's perspective.
+ * If no network is loaded, this is pieceSquareEval.
+ * @param state - Pointer to the current game state.
+ * @return The network's score, in pawns.
+ */
+double nnueEval(const GameState *state);
+
+#endif // NNUE_H_INCLUDED
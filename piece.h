@@ -25,6 +25,9 @@
 
 #define BLOCKERS 12
 
+// Converts a white piece type to the same type of the given color
+#define colorPiece(piece, white) ((piece) + NUM_PIECES / 2 * !(white))
+
 #define PIECE_STR "PNBRQKpnbrqk"
 
 typedef char Piece;
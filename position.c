@@ -13,6 +13,7 @@
 #include "movegen.h"
 #include "magic.h"
 #include "evaluate.h"
+#include "zobrist.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -38,6 +39,7 @@ GameState positionFromFenParts(const char *szBoard, const char *szTurn,
     char c;
     GameState state;
     state.prev = NULL;
+    state.numDirty = 0;
     state.fenInfo = 0;
     for(i=0; i<NUM_PIECES; i++) {
         pieceNum[(int) PIECE_STR[i]] = i;
@@ -94,12 +96,67 @@ GameState positionFromFenParts(const char *szBoard, const char *szTurn,
     setHalfMoveCounter(state, atoi(szHalfMoveCounter));
     setFullMoveCounter(state, atoi(szFullMoveCounter));
 
-    // Set material
+    // Set material and hash keys
     setMaterialScore(&state);
+    setZobristKeys(&state);
 
     return state;
 }
 
+int positionFromFenLine(const char *szLine, GameState *state) {
+    const char *parts[6];
+    int i, n;
+
+    // Find the start of each of the first six fields
+    for(i=n=0; n<6 && szLine[i] != '\0' && szLine[i] != '\n' && szLine[i] != '\r'; i++) {
+        if(szLine[i] != ' ' && (i == 0 || szLine[i - 1] == ' ')) {
+            parts[n++] = szLine + i;
+        }
+    }
+    if(n < 4) {
+        return 0;
+    }
+    // Fields after the ep target which aren't counters are EPD operations
+    for(i=4; i<n && '0' <= parts[i][0] && parts[i][0] <= '9'; i++) {}
+    for(; i<6; i++) {
+        parts[i] = i == 4 ? "0" : "1";
+    }
+    *state = positionFromFenParts(parts[0], parts[1], parts[2], parts[3], parts[4], parts[5]);
+    return 1;
+}
+
+void packPosition(const GameState *state, PackedPosition *packed) {
+    int i;
+    bitmask bm;
+
+    memset(packed, 0, sizeof(PackedPosition));
+    packed->occupancy = state->bb[BLOCKERS];
+    packed->fenInfo = state->fenInfo;
+    for(i=0, bm=state->bb[BLOCKERS]; bm; i++, bm&=bm-1) {
+        packed->pieces[i / 2] |= getPieceFromBitmask(state, bm & -bm) << (i % 2 * 4);
+    }
+}
+
+GameState unpackPosition(const PackedPosition *packed) {
+    GameState state;
+    int i;
+    bitmask bm;
+
+    for(i=0; i<NUM_PIECES; i++) {
+        state.bb[i] = NO_SQUARES;
+    }
+    state.bb[BLOCKERS] = packed->occupancy;
+    for(i=0, bm=packed->occupancy; bm; i++, bm&=bm-1) {
+        state.bb[packed->pieces[i / 2] >> (i % 2 * 4) & 0xF] |= bm & -bm;
+    }
+    state.prev = NULL;
+    state.numDirty = 0;
+    state.fenInfo = packed->fenInfo;
+    setMaterialScore(&state);
+    setZobristKeys(&state);
+    return state;
+}
+
 void positionToFen(GameState state, char *szFenBuffer) {
     int i, j, k, blanks, found;
 
@@ -171,7 +228,18 @@ int is50MoveRule(GameState state) {
 }
 
 int is3FoldRepetition(GameState state) {
-    // TODO
+    const GameState *prev;
+    int i, repetitions = 1;
+    // Only positions since the last capture or pawn move can repeat
+    for(i=1, prev=state.prev; prev != NULL && i <= getHalfMoveCounter(state); i++) {
+        if(prev->key == state.key && ++repetitions == 3) {
+            return 1;
+        }
+        if(prev->prev == prev) {
+            break;  // overwritten by its next state
+        }
+        prev = prev->prev;
+    }
     return 0;
 }
 
@@ -179,87 +247,91 @@ int isIllegalPosition(GameState state) {
     return sumBits(state.bb[W_KING]) != 1 ||
         sumBits(state.bb[B_KING]) != 1 ||
         state.bb[W_PAWN] | state.bb[B_PAWN] | RANK_1 | RANK_8 ||
-        getTurn(state) ? bInCheck(state) : wInCheck(state);
+        getTurn(state) ? bInCheck(&state) : wInCheck(&state);
 }
 
 #define u(x) shiftUp((x), 1)
 #define d(x) shiftDown((x), 1)
 #define l(x) shiftLeft((x), 1)
 #define r(x) shiftRight((x), 1)
-int bAttacks(GameState state, Square sq) {
+int bAttacks(const GameState *state, Square sq) {
     return
-        state.bb[B_PAWN] & (
+        state->bb[B_PAWN] & (
             u(l(1ULL << sq)) |
             u(r(1ULL << sq))) ||
-        KNIGHT_TABLE[sq] & state.bb[B_KNIGHT] ||
-        KING_TABLE[sq] & state.bb[B_KING] ||
-        hashRook(sq, state.bb[BLOCKERS]) &
-            (state.bb[B_ROOK] | state.bb[B_QUEEN]) ||
-        hashBishop(sq, state.bb[BLOCKERS]) &
-            (state.bb[B_BISHOP] | state.bb[B_QUEEN]);
+        KNIGHT_TABLE[sq] & state->bb[B_KNIGHT] ||
+        KING_TABLE[sq] & state->bb[B_KING] ||
+        hashRook(sq, state->bb[BLOCKERS]) &
+            (state->bb[B_ROOK] | state->bb[B_QUEEN]) ||
+        hashBishop(sq, state->bb[BLOCKERS]) &
+            (state->bb[B_BISHOP] | state->bb[B_QUEEN]);
 }
 
-int wAttacks(GameState state, Square sq) {
+int wAttacks(const GameState *state, Square sq) {
     return
-        state.bb[W_PAWN] & (
+        state->bb[W_PAWN] & (
             d(l(1ULL << sq)) |
             d(r(1ULL << sq))) ||
-        KNIGHT_TABLE[sq] & state.bb[W_KNIGHT] ||
-        KING_TABLE[sq] & state.bb[W_KING] ||
-        hashRook(sq, state.bb[BLOCKERS]) &
-            (state.bb[W_ROOK] | state.bb[W_QUEEN]) ||
-        hashBishop(sq, state.bb[BLOCKERS]) &
-            (state.bb[W_BISHOP] | state.bb[W_QUEEN]);
+        KNIGHT_TABLE[sq] & state->bb[W_KNIGHT] ||
+        KING_TABLE[sq] & state->bb[W_KING] ||
+        hashRook(sq, state->bb[BLOCKERS]) &
+            (state->bb[W_ROOK] | state->bb[W_QUEEN]) ||
+        hashBishop(sq, state->bb[BLOCKERS]) &
+            (state->bb[W_BISHOP] | state->bb[W_QUEEN]);
 }
 #undef u
 #undef d
 #undef l
 #undef r
 
-int wInCheck(GameState state) {
-    return bAttacks(state, LSB(state.bb[W_KING]) - 1);
+int wInCheck(const GameState *state) {
+    return bAttacks(state, LSB(state->bb[W_KING]) - 1);
+}
+
+int bInCheck(const GameState *state) {
+    return wAttacks(state, LSB(state->bb[B_KING]) - 1);
 }
 
-int bInCheck(GameState state) {
-    return wAttacks(state, LSB(state.bb[B_KING]) - 1);
+bitmask getAllAttacks(const GameState *state, int white) {
+    return getAttacksWithOccupancy(state, white, state->bb[BLOCKERS]);
 }
 
-bitmask getAllAttacks(GameState state, int white) {
+bitmask getAttacksWithOccupancy(const GameState *state, int white, bitmask occupancy) {
     int square;
     bitmask bm, attacks = 0ULL;
     white = !!white;
 
-    for(bm = state.bb[B_ROOK - 6 * white] |
-            state.bb[B_QUEEN - 6 * white];
+    for(bm = state->bb[B_ROOK - 6 * white] |
+            state->bb[B_QUEEN - 6 * white];
             bm;
             bm &= ~(1ULL << square)) {
         square = LSB(bm) - 1;
-        attacks |= hashRook(square, state.bb[BLOCKERS]);
+        attacks |= hashRook(square, occupancy);
     }
 
-    for(bm = state.bb[B_BISHOP - 6 * white] |
-            state.bb[B_QUEEN - 6 * white];
+    for(bm = state->bb[B_BISHOP - 6 * white] |
+            state->bb[B_QUEEN - 6 * white];
             bm;
             bm &= ~(1ULL << square)) {
         square = LSB(bm) - 1;
-        attacks |= hashBishop(square, state.bb[BLOCKERS]);
+        attacks |= hashBishop(square, occupancy);
     }
 
-    for(bm = state.bb[B_KNIGHT - 6 * white];
+    for(bm = state->bb[B_KNIGHT - 6 * white];
             bm;
             bm &= ~(1ULL << square)) {
         square = LSB(bm) - 1;
         attacks |= KNIGHT_TABLE[square];
     }
 
-    for(bm = state.bb[B_KING - 6 * white];
+    for(bm = state->bb[B_KING - 6 * white];
             bm;
             bm &= ~(1ULL << square)) {
         square = LSB(bm) - 1;
         attacks |= KING_TABLE[square];
     }
 
-    for(bm = state.bb[B_PAWN - 6 * white];
+    for(bm = state->bb[B_PAWN - 6 * white];
             bm;
             bm &= ~(1ULL << square)) {
         square = LSB(bm) - 1;
@@ -269,14 +341,28 @@ bitmask getAllAttacks(GameState state, int white) {
     return attacks;
 }
 
-int getPieceFromSquare(GameState state, Square square) {
+bitmask getAttackersTo(const GameState *state, Square sq, bitmask occupancy) {
+    return
+        (PAWN_TABLE[0][sq] & state->bb[W_PAWN]) |
+        (PAWN_TABLE[1][sq] & state->bb[B_PAWN]) |
+        (KNIGHT_TABLE[sq] & (state->bb[W_KNIGHT] | state->bb[B_KNIGHT])) |
+        (KING_TABLE[sq] & (state->bb[W_KING] | state->bb[B_KING])) |
+        (hashRook(sq, occupancy) & (
+            state->bb[W_ROOK] | state->bb[W_QUEEN] |
+            state->bb[B_ROOK] | state->bb[B_QUEEN])) |
+        (hashBishop(sq, occupancy) & (
+            state->bb[W_BISHOP] | state->bb[W_QUEEN] |
+            state->bb[B_BISHOP] | state->bb[B_QUEEN]));
+}
+
+int getPieceFromSquare(const GameState *state, Square square) {
     return getPieceFromBitmask(state, 1ULL << square);
 }
 
-int getPieceFromBitmask(GameState state, bitmask square) {
+int getPieceFromBitmask(const GameState *state, bitmask square) {
     int i;
     for(i=0; i<NUM_PIECES; i++) {
-        if(state.bb[i] & square) {
+        if(state->bb[i] & square) {
             return i;
         }
     }
@@ -13,6 +13,8 @@
 #include "piece.h"
 #include "square.h"
 
+#include <stdint.h>
+
 #define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
 
 #define getTurn(state) ((state).fenInfo & 1)
@@ -59,14 +61,51 @@
  * Bits 12-18: Half move counter (only up to 50 is needed)
  * Bits 19-31: Full move counter (can hold theoretical max no. of moves)
  * The material value is updated incrementally to save on computations.
+ * So are the middlegame and endgame piece-square table sums and the game
+ * phase, which blends them (see evaluate.h), and the Zobrist key of the
+ * position and of its pawns alone (see zobrist.h). While the network is
+ * the evaluation, make-move also records the pieces it moved from the
+ * previous state, so that the network's accumulator can be updated from
+ * the previous state's (see nnue.h).
  */
+typedef struct DirtyPiece {
+    unsigned char piece, from, to, toPiece;  // toPiece is NUM_PIECES if taken
+} DirtyPiece;
+
+// numDirty when make-move didn't record the dirty pieces
+#define UNKNOWN_DIRTY -1
+
 typedef struct GameState {
     bitmask bb[NUM_PIECES + 1]; // Last index for blockers
-    struct GameState *prev;
+    const struct GameState *prev;
     int fenInfo;
     double material;
+    double pstMidgame, pstEndgame;
+    int phase;
+    bitmask key, pawnKey;
+    DirtyPiece dirty[3];  // the moved piece, a captured piece and a rook
+    int numDirty;
 } GameState;
 
+/* A position packed into 32 bytes along with a score and game result,
+ * for training data. occupancy holds the occupied squares, and pieces the
+ * piece on each of them from a1 to h8, 4 bits each starting with the low
+ * bits of pieces[0]. fenInfo is as in GameState. Like the result, the
+ * score is from white's perspective: the score is in centipawns, and the
+ * result is 1 for a white win, 0 for a draw or -1 for a black win. Files
+ * of packed positions are little endian.
+ */
+typedef struct PackedPosition {
+    bitmask occupancy;
+    uint8_t pieces[16];
+    int32_t fenInfo;
+    int16_t score;
+    int8_t result;
+    uint8_t unused;
+} PackedPosition;
+
+_Static_assert(sizeof(PackedPosition) == 32, "PackedPosition must be 32 bytes");
+
 /**
  * Creates a game from a FEN string.
  * @param fen - The FEN string to convert.
@@ -87,6 +126,32 @@ GameState positionFromFenParts(const char *szBoard, const char *szTurn,
     const char *szCastlingRights, const char *szEPTarget,
     const char *szHalfMoveCounter, const char *szFullMoveCounter);
 
+/**
+ * Creates a game from the FEN at the start of a line, which ends at a
+ * newline or the end of the string. The move counters may be left off,
+ * as in EPD, and anything after the FEN is ignored.
+ * @param szLine - The line to read.
+ * @param state - Output for the GameState.
+ * @return TRUE if the line has at least the first four FEN fields.
+ * FALSE otherwise, in which case state is unchanged.
+ */
+int positionFromFenLine(const char *szLine, GameState *state);
+
+/**
+ * Packs a position. The score and result are set to 0.
+ * @param state - Pointer to the state to pack.
+ * @param packed - Output for the packed position.
+ */
+void packPosition(const GameState *state, PackedPosition *packed);
+
+/**
+ * Unpacks a position packed by packPosition. The state has no previous
+ * state.
+ * @param packed - Pointer to the packed position.
+ * @return The unpacked state.
+ */
+GameState unpackPosition(const PackedPosition *packed);
+
 /**
  * Writes the FEN string into a given buffer.
  * @param state - The state to write.
@@ -102,7 +167,8 @@ void positionToFen(GameState state, char *szBuffer);
 int is50MoveRule(GameState state);
 
 /**
- * Checks whether the position is a draw by 3-fold repetition.
+ * Checks whether the position is a draw by 3-fold repetition, by
+ * comparing its key to those of the previous states it was reached from.
  * @param state - The position to check.
  * @return - TRUE if the position is 3-fold repetition. FALSE otherwise.
  */
@@ -118,60 +184,83 @@ int isIllegalPosition(GameState state);
 
 /**
  * Checks whether or not black attacks a square.
- * @param state - The position to check.
+ * @param state - Pointer to the position to check.
  * @param sq - The square to check.
  * @return TRUE if black attacks the square. FALSE otherwise.
  */
-int bAttacks(GameState state, Square sq);
+int bAttacks(const GameState *state, Square sq);
 
 /**
  * Checks whether or not black is in check.
- * @param state - The position to check.
+ * @param state - Pointer to the position to check.
  * @param sq - The square to check.
  * @return TRUE if white attacks the square. FALSE otherwise.
  */
-int wAttacks(GameState state, Square sq);
+int wAttacks(const GameState *state, Square sq);
 
 /**
  * Checks whether or not white is in check.
- * @param state - The position to check.
+ * @param state - Pointer to the position to check.
  * @return TRUE if white is in check. FALSE otherwise.
  */
-int wInCheck(GameState state);
+int wInCheck(const GameState *state);
 
 /**
  * Checks whether or not black is in check.
- * @param state - The position to check.
+ * @param state - Pointer to the position to check.
  * @return TRUE if black is in check. FALSE otherwise.
  */
-int bInCheck(GameState state);
+int bInCheck(const GameState *state);
 
 /**
  * Return a bitmask of all attacked squares for one side.
  * This does not include pins.
- * @param state - The current game state to evaluate.
+ * @param state - Pointer to the current game state to evaluate.
  * @param white - TRUE to get white's attacks.
  * FALSE to get black's attacks.
  */
-bitmask getAllAttacks(GameState state, int white);
+bitmask getAllAttacks(const GameState *state, int white);
+
+/**
+ * Return a bitmask of all attacked squares for one side, with sliding
+ * pieces blocked by the given occupancy instead of the position's.
+ * Removing the enemy king from the occupancy shows which squares it
+ * may not step back to along a slider's ray.
+ * @param state - Pointer to the current game state to evaluate.
+ * @param white - TRUE to get white's attacks.
+ * FALSE to get black's attacks.
+ * @param occupancy - The squares which block sliding pieces.
+ */
+bitmask getAttacksWithOccupancy(const GameState *state, int white, bitmask occupancy);
+
+/**
+ * Return a bitmask of all pieces of both colors which attack a square,
+ * given the occupied squares. Sliding pieces are blocked by the given
+ * occupancy rather than the board's, so that x-rays can be found.
+ * @param state - Pointer to the current game state.
+ * @param sq - The square attacked.
+ * @param occupancy - The occupied squares.
+ * @return A bitmask of the attacking pieces.
+ */
+bitmask getAttackersTo(const GameState *state, Square sq, bitmask occupancy);
 
 /**
  * Gets the piece sitting on the given square.
- * @param state - The state to check.
+ * @param state - Pointer to the state to check.
  * @param square - The square to check.
  * @return The piece sitting on the square,
  * or 12 (NUM_PIECES) if no such square exists.
  * @see getPieceFromBitmask
  */
-int getPieceFromSquare(GameState state, Square square);
+int getPieceFromSquare(const GameState *state, Square square);
 
 /**
  * Gets the piece sitting on the given square.
- * @param state - The state to check.
+ * @param state - Pointer to the state to check.
  * @param square - The square to check, as a bitmask.
  * @return The piece sitting on the square,
  * or 12 (NUM_PIECES) if no such square exists.
  */
-int getPieceFromBitmask(GameState state, bitmask square);
+int getPieceFromBitmask(const GameState *state, bitmask square);
 
 #endif // POSITION_H_INCLUDED
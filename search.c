@@ -8,9 +8,11 @@
 
 #include "search.h"
 #include "bitboard.h"
+#include "bitbase.h"
 #include "move.h"
 #include "movegen.h"
 #include "config.h"
+#include "see.h"
 #include "debug.h"
 
 #include <stdlib.h>
@@ -20,6 +22,14 @@
 #include <math.h>
 #include <float.h>
 
+// The width of a null window, for searches which only test a bound
+#define MIN_WINDOW 0.001
+
+// Depth reductions for late moves, indexed by depth and move number
+static int LMR_TABLE[64][64];
+
+_Thread_local unsigned long lazyEvalSkips;
+
 Move getRandomMove(GameState state) {
     int n;
     Move moveBuffer[MAX_MOVES];
@@ -27,101 +37,288 @@ Move getRandomMove(GameState state) {
     return moveBuffer[rand() % n];
 }
 
-moveScoreLeaves miniMax(GameState curState, int ply, double alpha, double beta, double prevScore) {
-    double staticScore, bestScore, jScore;
-    int numMoves, i, j, stop, maxIdx, turn;
-    Move bestMove = -1,
-         secondBestMove = -1,
-         legalMoves[MAX_MOVES],
-         tempMove;
-    moveScoreLeaves finalMoveInfo, temp;
-
-    pthread_testcancel();
-    generateLegalMoves(&curState, legalMoves, &numMoves);
-    staticScore = evaluationFunction(curState);
-    turn = getTurn(curState);
-
-    if(numMoves == 0) {
-        finalMoveInfo.leaves = 1;
-        if (turn ? wInCheck(curState) : bInCheck(curState)) {
-            finalMoveInfo.score = turn ? -DBL_MAX : DBL_MAX;
-        } else {
-            finalMoveInfo.score = 0;
+void searchInit() {
+    int depth, moveNum;
+    for(depth=0; depth<64; depth++) {
+        for(moveNum=0; moveNum<64; moveNum++) {
+            LMR_TABLE[depth][moveNum] = depth && moveNum ?
+                (int) (0.75 + log(depth) * log(moveNum) / 2.25) : 0;
         }
-        return finalMoveInfo;
     }
+    selectSearch();
+}
+
+void initSearchThread(SearchThread *thread) {
+    memset(thread->killers, -1, sizeof(thread->killers));
+    memset(thread->history, 0, sizeof(thread->history));
+    thread->pvLength[0] = 0;
+    thread->nullMinHeight = 0;
+    thread->prevPVLength = 0;
+    thread->followPV = 0;
+}
 
-    if(ply <= -quiescenceMaxDepth ||
-       (ply <= 0 && (searchStrategy != MINIMAX_QUIESCENCE ||
-            fabs(staticScore - prevScore) < quiescenceCutoff))) {
-        finalMoveInfo.leaves = 1;
-        finalMoveInfo.score = staticScore;
-        return finalMoveInfo;
+void startIteration(SearchThread *thread) {
+    int i;
+    for(i=0; i<thread->pvLength[0]; i++) {
+        thread->prevPV[i] = thread->pv[0][i];
     }
+    thread->prevPVLength = thread->pvLength[0];
+    thread->followPV = thread->prevPVLength > 0;
+}
 
-    finalMoveInfo.leaves = 0;
-    temp.leaves = 0;
-
-    if(pruning & NULL_PRUNING &&
-       (turn ? !wInCheck(curState) : !bInCheck(curState))) {
-        temp = miniMax(pushMove(&curState, NULL_MOVE),
-                       ply - 1, alpha, beta, staticScore);
-        finalMoveInfo.leaves += temp.leaves;
-        bestMove = NULL_MOVE;
-        if(turn) {
-            if(temp.score > alpha) {
-                alpha = temp.score;
-            }
-        } else if(temp.score < beta) {
-            beta = temp.score;
-        }
-        // TODO what should happen here if alpha >= beta?
+/**
+ * Private function.
+ * Checks whether a side has any pieces besides pawns and the king.
+ * @param state - Pointer to the current game state.
+ * @param white - TRUE to check white's pieces. FALSE for black's.
+ * @return TRUE if the side has a knight, bishop, rook or queen.
+ */
+static int hasNonPawnMaterial(const GameState *state, int white) {
+    int offset = white ? 0 : NUM_PIECES / 2;
+    return !!(state->bb[W_KNIGHT + offset] | state->bb[W_BISHOP + offset] |
+              state->bb[W_ROOK + offset] | state->bb[W_QUEEN + offset]);
+}
+
+/**
+ * Private function.
+ * Stores a move as the best move at the given height, followed by
+ * the principal variation found one ply deeper.
+ * @param thread - The search thread's own data.
+ * @param height - The number of ply from the root.
+ * @param m - The best move found at this height.
+ */
+static void updatePV(SearchThread *thread, int height, Move m) {
+    int i;
+    thread->pv[height][height] = m;
+    for(i=height+1; i<thread->pvLength[height + 1]; i++) {
+        thread->pv[height][i] = thread->pv[height + 1][i];
     }
+    thread->pvLength[height] = thread->pvLength[height + 1];
+}
 
-    // TODO: optimize by saving pushed state
-    stop = (pruning & FORWARD_PRUNING) && forwardPruneN < numMoves ? forwardPruneN : numMoves;
-    for(i=0; i<stop; i++) {
-        if(pruning & FORWARD_PRUNING) {
-            maxIdx = i;
-            bestScore = evaluationFunction(pushMove(&curState, legalMoves[maxIdx]));
-            for(j=i+1; j<numMoves; j++) {
-                jScore = evaluationFunction(pushMove(&curState, legalMoves[j]));
-                if(turn ? jScore > bestScore : jScore < bestScore) {
-                    maxIdx = j;
-                    bestScore = jScore;
-                }
-            }
-            tempMove = legalMoves[maxIdx];
-            legalMoves[maxIdx] = legalMoves[i];
-            legalMoves[i] = tempMove;
-        }
+/**
+ * Private function.
+ * Orders a capture or promotion by the most valuable victim,
+ * then by the least valuable attacker.
+ * @param m - The move to score.
+ * @return A higher score for moves which should be searched first.
+ */
+static double captureOrderScore(Move m) {
+    double gain = fabs(pieceValues[getCapturedPiece(m)]);
+    if(isPromotion(m)) {
+        gain += fabs(pieceValues[getPromotionPiece(m)]);
+    }
+    return gain * 100 - fabs(pieceValues[getMovedPiece(m)]);
+}
 
-        // get score from recursive call
-        temp = miniMax(pushMove(&curState, legalMoves[i]),
-                       ply - 1, alpha, beta, staticScore);
-
-        finalMoveInfo.leaves += temp.leaves;
-
-        if(turn) {
-            if(temp.score > alpha) {
-                alpha = temp.score;
-                secondBestMove = bestMove;
-                bestMove = legalMoves[i];
-            }
-        } else if(temp.score < beta) {
-            beta = temp.score;
-            secondBestMove = bestMove;
-            bestMove = legalMoves[i];
+/**
+ * Private function.
+ * Selection sort step: swaps the highest scored move from index i
+ * onward into index i.
+ * @param moves - The moves to order.
+ * @param scores - The ordering score of each move.
+ * @param n - The number of moves.
+ * @param i - The index to fill.
+ */
+static void pickMove(Move *moves, double *scores, int n, int i) {
+    int j, best = i;
+    Move tempMove;
+    double tempScore;
+    for(j=i+1; j<n; j++) {
+        if(scores[j] > scores[best]) {
+            best = j;
         }
+    }
+    tempMove = moves[i];
+    moves[i] = moves[best];
+    moves[best] = tempMove;
+    tempScore = scores[i];
+    scores[i] = scores[best];
+    scores[best] = tempScore;
+}
 
-        if((pruning & AB_PRUNING) && beta <= alpha) {
-            finalMoveInfo.move = bestMove;
-            finalMoveInfo.score = turn ? alpha : beta;
-            return finalMoveInfo;
+/**
+ * Private function.
+ * Scores moves so that the most promising are searched first: the move
+ * from the previous principal variation, then captures and promotions
+ * which don't lose material by MVV-LVA, then killer moves, then other
+ * quiet moves by their history, then losing captures.
+ * @param thread - The search thread's own data.
+ * @param state - Pointer to the current game state.
+ * @param height - The number of ply from the root.
+ * @param moves - The moves to score.
+ * @param scores - Output for the ordering score of each move.
+ * @param n - The number of moves.
+ * @param pvMove - The move from the previous principal variation, or -1.
+ */
+static void scoreMoves(SearchThread *thread, const GameState *state, int height,
+                       Move *moves, double *scores, int n, Move pvMove) {
+    int i;
+    for(i=0; i<n; i++) {
+        if(moves[i] == pvMove) {
+            scores[i] = 1e9;
+        } else if(!isQuiet(moves[i])) {
+            scores[i] = (seeGE(state, moves[i], 0) ? 1e7 : -1e7) +
+                        captureOrderScore(moves[i]);
+        } else if(moves[i] == thread->killers[height][0]) {
+            scores[i] = 1e6 + 1;
+        } else if(moves[i] == thread->killers[height][1]) {
+            scores[i] = 1e6;
+        } else {
+            scores[i] = thread->history[getMovedPiece(moves[i])][getDestination(moves[i])];
         }
-     }
+    }
+}
+
+/**
+ * Private function.
+ * Evaluates a state for a search window. When the material is more than
+ * lazyEvalMargin outside the window, the other terms are assumed unable
+ * to bring the score inside it, so the evaluation is skipped and the
+ * material plus or minus the margin is returned as a bound. Bounds are
+ * not cached. Otherwise this is cachedEval.
+ * @param state - Pointer to the current game state.
+ * @param alpha - The lower bound of the search window.
+ * @param beta - The upper bound of the search window.
+ * @param evaluate - The evaluation function.
+ * @return The static score of the state, or a bound outside the window.
+ */
+ALWAYS_INLINE double lazyEval(const GameState *state, double alpha, double beta,
+                              double (*evaluate)(const GameState*)) {
+    if(state->material + lazyEvalMargin <= alpha) {
+        lazyEvalSkips++;
+        return state->material + lazyEvalMargin;
+    }
+    if(state->material - lazyEvalMargin >= beta) {
+        lazyEvalSkips++;
+        return state->material - lazyEvalMargin;
+    }
+    return cachedEval(state, evaluate);
+}
+
+typedef moveScoreLeaves (*SearchFunction)(SearchThread *thread, const GameState *curState,
+                                          int ply, int height, double alpha, double beta);
+
+/* A search instance pairs the minimax and quiescence searches compiled
+ * for one configuration.
+ */
+typedef struct SearchInstance {
+    SearchFunction miniMax, quiescence;
+} SearchInstance;
+
+/* Each evaluation gets a generic instance, which reads the pruning and
+ * searchStrategy options at run time, and a production instance with
+ * PRODUCTION_PRUNING and PRODUCTION_STRATEGY compiled in. Evaluations
+ * costing more than a lookup go through the evaluation cache, and those
+ * built on the material go through lazy evaluation first. The network's
+ * score is not built on the material, so it is never skipped.
+ */
+#define EVALUATE(state, alpha, beta) materialEval(state)
+#define SEARCH_NAME(name) name##Material
+#define PRUNING pruning
+#define STRATEGY searchStrategy
+#include "searchbody.h"
+#define SEARCH_NAME(name) name##MaterialProduction
+#define PRUNING PRODUCTION_PRUNING
+#define STRATEGY PRODUCTION_STRATEGY
+#include "searchbody.h"
+#undef EVALUATE
+
+#define EVALUATE(state, alpha, beta) lazyEval(state, alpha, beta, valueAndInfluence)
+#define SEARCH_NAME(name) name##Influence
+#define PRUNING pruning
+#define STRATEGY searchStrategy
+#include "searchbody.h"
+#define SEARCH_NAME(name) name##InfluenceProduction
+#define PRUNING PRODUCTION_PRUNING
+#define STRATEGY PRODUCTION_STRATEGY
+#include "searchbody.h"
+#undef EVALUATE
+
+#define EVALUATE(state, alpha, beta) lazyEval(state, alpha, beta, valueAndMobility)
+#define SEARCH_NAME(name) name##Mobility
+#define PRUNING pruning
+#define STRATEGY searchStrategy
+#include "searchbody.h"
+#define SEARCH_NAME(name) name##MobilityProduction
+#define PRUNING PRODUCTION_PRUNING
+#define STRATEGY PRODUCTION_STRATEGY
+#include "searchbody.h"
+#undef EVALUATE
+
+#define EVALUATE(state, alpha, beta) lazyEval(state, alpha, beta, attackMapEval)
+#define SEARCH_NAME(name) name##AttackMap
+#define PRUNING pruning
+#define STRATEGY searchStrategy
+#include "searchbody.h"
+#define SEARCH_NAME(name) name##AttackMapProduction
+#define PRUNING PRODUCTION_PRUNING
+#define STRATEGY PRODUCTION_STRATEGY
+#include "searchbody.h"
+#undef EVALUATE
+
+#define EVALUATE(state, alpha, beta) pieceSquareEval(state)
+#define SEARCH_NAME(name) name##PieceSquare
+#define PRUNING pruning
+#define STRATEGY searchStrategy
+#include "searchbody.h"
+#define SEARCH_NAME(name) name##PieceSquareProduction
+#define PRUNING PRODUCTION_PRUNING
+#define STRATEGY PRODUCTION_STRATEGY
+#include "searchbody.h"
+#undef EVALUATE
+
+#define EVALUATE(state, alpha, beta) lazyEval(state, alpha, beta, positionalEval)
+#define SEARCH_NAME(name) name##Positional
+#define PRUNING pruning
+#define STRATEGY searchStrategy
+#include "searchbody.h"
+#define SEARCH_NAME(name) name##PositionalProduction
+#define PRUNING PRODUCTION_PRUNING
+#define STRATEGY PRODUCTION_STRATEGY
+#include "searchbody.h"
+#undef EVALUATE
+
+#define EVALUATE(state, alpha, beta) cachedEval(state, nnueEval)
+#define SEARCH_NAME(name) name##Nnue
+#define PRUNING pruning
+#define STRATEGY searchStrategy
+#include "searchbody.h"
+#define SEARCH_NAME(name) name##NnueProduction
+#define PRUNING PRODUCTION_PRUNING
+#define STRATEGY PRODUCTION_STRATEGY
+#include "searchbody.h"
+#undef EVALUATE
+
+#define GENERIC_INSTANCE(index, function, suffix) \
+    [index] = {miniMax##suffix, quiescence##suffix},
+#define PRODUCTION_INSTANCE(index, function, suffix) \
+    [index] = {miniMax##suffix##Production, quiescence##suffix##Production},
+static const SearchInstance GENERIC_SEARCH[NUM_EVALUATION_FUNCS] = {
+    EVALUATION_FUNCS(GENERIC_INSTANCE)
+};
+static const SearchInstance PRODUCTION_SEARCH[NUM_EVALUATION_FUNCS] = {
+    EVALUATION_FUNCS(PRODUCTION_INSTANCE)
+};
+#undef GENERIC_INSTANCE
+#undef PRODUCTION_INSTANCE
+
+// The instance chosen by selectSearch for the current options
+static SearchInstance selectedSearch;
+
+void selectSearch() {
+    int i = evaluation >= 0 && evaluation < NUM_EVALUATION_FUNCS ?
+        evaluation : MATERIAL_EVAL;
+    selectedSearch = searchStrategy == PRODUCTION_STRATEGY && pruning == PRODUCTION_PRUNING ?
+        PRODUCTION_SEARCH[i] : GENERIC_SEARCH[i];
+}
+
+moveScoreLeaves miniMax(SearchThread *thread, const GameState *curState, int ply, int height,
+                        double alpha, double beta) {
+    return selectedSearch.miniMax(thread, curState, ply, height, alpha, beta);
+}
 
-    finalMoveInfo.move = NULL_MOVE == bestMove ? secondBestMove : bestMove;
-    finalMoveInfo.score = turn ? alpha : beta;
-    return finalMoveInfo;
+moveScoreLeaves quiescence(SearchThread *thread, const GameState *curState, int qply, int height,
+                           double alpha, double beta) {
+    return selectedSearch.quiescence(thread, curState, qply, height, alpha, beta);
 }
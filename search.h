@@ -11,6 +11,22 @@
 #include "move.h"
 #include "position.h"
 
+/* The maximum number of ply from the root that a search can reach,
+ * including the quiescence search below the horizon.
+ */
+#define MAX_PLY 128
+
+/* Checkmate is scored as MATE_SCORE less the number of ply from the root,
+ * so that shorter mates are preferred. Scores are from white's perspective.
+ */
+#define MATE_SCORE 10000.0
+#define isMateScore(score) (fabs(score) >= MATE_SCORE - MAX_PLY)
+
+/* A position won according to the bitbases scores BITBASE_WIN_SCORE plus
+ * its static evaluation, so that the search still prefers progress.
+ */
+#define BITBASE_WIN_SCORE (MATE_SCORE / 2)
+
 /* A move score leaves struct has three fields:
  * a Move
  * the best score for this move (double)
@@ -22,6 +38,59 @@ typedef struct moveScoreLeaves {
     unsigned long leaves;
 } moveScoreLeaves;
 
+/* A search thread holds the data each searching thread keeps for itself.
+ * The principal variation is stored in a triangular table: pv[h] holds
+ * the best line found from height h (ply from the root), running from
+ * pv[h][h] up to pv[h][pvLength[h] - 1]. prevPV is the line found by the
+ * previous iteration, which is searched first while followPV is set.
+ * currentMove[h] is the move being searched at height h, and the null move
+ * is not tried below nullMinHeight while a null move search is verified.
+ * Killer moves are quiet moves which caused a cutoff at the same height,
+ * and the history table scores quiet moves by piece and destination.
+ */
+typedef struct SearchThread {
+    Move pv[MAX_PLY][MAX_PLY];
+    int pvLength[MAX_PLY];
+    Move prevPV[MAX_PLY];
+    Move currentMove[MAX_PLY];
+    Move killers[MAX_PLY][2];
+    double history[NUM_PIECES][NUM_SQUARES];
+    int prevPVLength, followPV, nullMinHeight;
+} SearchThread;
+
+/* The number of evaluations the calling thread's searches have skipped
+ * because the material was far outside the search window. A search runs
+ * in a new thread, so this starts at 0 for each search.
+ */
+extern _Thread_local unsigned long lazyEvalSkips;
+
+/**
+ * This function should be called on program start to initialize
+ * the tables used by the search.
+ */
+void searchInit();
+
+/**
+ * Clears a search thread's data before searching a new position.
+ * @param thread - The search thread to clear.
+ */
+void initSearchThread(SearchThread *thread);
+
+/**
+ * Prepares a search thread for the next iteration of iterative deepening.
+ * The principal variation from the last iteration is kept so that it
+ * is searched first.
+ * @param thread - The search thread to prepare.
+ */
+void startIteration(SearchThread *thread);
+
+/**
+ * Selects the compiled search instance for the current searchStrategy,
+ * pruning and evaluation options. This should be called whenever one of
+ * them changes. searchInit calls it for the options at program start.
+ */
+void selectSearch();
+
 /**
  * Gets a random legal move.
  * @param state - The current state of the game.
@@ -30,13 +99,33 @@ typedef struct moveScoreLeaves {
 Move getRandomMove(GameState state);
 
 /**
- * Finds the best move from a game state.
- * @param curState - The current state of the game.
+ * Finds the best move from a game state. The principal variation is
+ * written to the search thread's PV table at the given height.
+ * @param thread - The search thread's own data.
+ * @param curState - Pointer to the current state of the game.
+ * @param ply - The remaining depth to search.
+ * @param height - The number of ply from the root (0 at the root).
  * @param alpha - -INFINITY initially. Increases with recursive calls
  * @param beta - INFINITY initially. Decreases with recursive calls
- * @param prevScore - static evaluation of the preceding position
  * @return A moveScoreLeaves containing the best score and best move.
  */
-moveScoreLeaves miniMax(GameState curState, int ply, double alpha, double beta, double prevScore);
+moveScoreLeaves miniMax(SearchThread *thread, const GameState *curState, int ply, int height,
+                        double alpha, double beta);
+
+/**
+ * Searches captures and promotions below the horizon until the position
+ * is quiet. The side to move may stand pat on the static evaluation
+ * instead of capturing, unless it is in check, in which case every
+ * evasion is searched.
+ * @param thread - The search thread's own data.
+ * @param curState - Pointer to the current state of the game.
+ * @param qply - The number of ply searched past the horizon.
+ * @param height - The number of ply from the root.
+ * @param alpha - The lower bound of the search window.
+ * @param beta - The upper bound of the search window.
+ * @return A moveScoreLeaves containing the best score.
+ */
+moveScoreLeaves quiescence(SearchThread *thread, const GameState *curState, int qply, int height,
+                           double alpha, double beta);
 
 #endif // SEARCH_H_INCLUDED
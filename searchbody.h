@@ -0,0 +1,389 @@
+/**
+ * searchbody.h holds the body of the minimax and quiescence searches.
+ * It is included by search.c once per configuration the search is
+ * specialised for, with these macros defined beforehand:
+ *
+ * SEARCH_NAME(name) - pastes the instance suffix onto a function name
+ * EVALUATE(state, alpha, beta) - the static evaluation called at each
+ *     node, which may return a bound outside the window instead
+ * PRUNING - the pruning switches, either constant or the pruning global
+ * STRATEGY - the search strategy, either constant or searchStrategy
+ *
+ * When PRUNING and STRATEGY are constants the compiler removes the
+ * branches for disabled switches, and EVALUATE is a direct call which
+ * can be inlined instead of a call through evaluationFunction.
+ * SEARCH_NAME, PRUNING and STRATEGY are undefined at the end.
+ * There is intentionally no include guard.
+ * @author Blake Herrera
+ * @date 2023-04-27
+ * @see search.c
+ */
+
+static moveScoreLeaves SEARCH_NAME(quiescence)(SearchThread *thread, const GameState *curState,
+                                               int qply, int height, double alpha, double beta);
+
+static moveScoreLeaves SEARCH_NAME(miniMax)(SearchThread *thread, const GameState *curState,
+                                            int ply, int height, double alpha, double beta) {
+    double staticScore, childScore, scores[MAX_MOVES];
+    int numMoves, i, stop, turn, inCheck, givesCheck, quiet,
+        frontier, futile, R, nullMinHeight, newPly, wdl;
+    Move bestMove = -1,
+         pvMove = -1,
+         legalMoves[MAX_MOVES];
+    GameState nextState;
+    moveScoreLeaves finalMoveInfo, temp;
+
+    pthread_testcancel();
+    thread->pvLength[height] = height;
+    turn = getTurn(*curState);
+    inCheck = turn ? wInCheck(curState) : bInCheck(curState);
+
+    /* A capture or promotion into an ending in the bitbases is scored
+     * exactly, unless it is checkmate. The ending the search started in
+     * is searched as usual, since a won score alone makes no progress.
+     */
+    if(height > 0 && thread->currentMove[height - 1] != NULL_MOVE &&
+       (isCapture(thread->currentMove[height - 1]) ||
+        isPromotion(thread->currentMove[height - 1])) &&
+       POPCOUNT(curState->bb[BLOCKERS]) <= MAX_BITBASE_PIECES &&
+       (wdl = bitbaseProbe(curState)) != BITBASE_UNKNOWN &&
+       (!inCheck || hasLegalMove(curState))) {
+        finalMoveInfo.leaves = 1;
+        finalMoveInfo.score = wdl == BITBASE_DRAW ? 0 : (turn ? wdl : -wdl) * BITBASE_WIN_SCORE +
+                              EVALUATE(curState, -INFINITY, INFINITY);
+        return finalMoveInfo;
+    }
+
+    if(ply <= 0 && STRATEGY == MINIMAX_QUIESCENCE) {
+        return SEARCH_NAME(quiescence)(thread, curState, 0, height, alpha, beta);
+    }
+
+    /* Leaves are most of the tree, so no moves are generated here.
+     * Only a side in check can be mated, so only then is it checked
+     * for a legal move. Stalemate is not detected at the horizon.
+     */
+    if(ply <= 0 || height >= MAX_PLY - 1) {
+        finalMoveInfo.leaves = 1;
+        if(inCheck && !hasLegalMove(curState)) {
+            finalMoveInfo.score = turn ? height - MATE_SCORE : MATE_SCORE - height;
+        } else {
+            finalMoveInfo.score = EVALUATE(curState, alpha, beta);
+        }
+        return finalMoveInfo;
+    }
+
+    generateLegalMoves(curState, legalMoves, &numMoves);
+    if(numMoves == 0) {
+        finalMoveInfo.leaves = 1;
+        if (inCheck) {
+            finalMoveInfo.score = turn ? height - MATE_SCORE : MATE_SCORE - height;
+        } else {
+            finalMoveInfo.score = 0;
+        }
+        return finalMoveInfo;
+    }
+    // The pruning below measures margins from this, so it must be exact
+    staticScore = EVALUATE(curState, -INFINITY, INFINITY);
+
+    finalMoveInfo.leaves = 0;
+    temp.leaves = 0;
+
+    // Search the previous iteration's principal variation first
+    if(thread->followPV) {
+        thread->followPV = 0;
+        for(i=0; height<thread->prevPVLength && i<numMoves; i++) {
+            if(legalMoves[i] == thread->prevPV[height]) {
+                pvMove = thread->prevPV[height];
+                thread->followPV = 1;
+                break;
+            }
+        }
+    }
+
+    // Frontier nodes, away from the principal variation and checks
+    frontier = ply <= 3 && height > 0 && !thread->followPV && !inCheck &&
+               !isMateScore(alpha) && !isMateScore(beta) && (PRUNING & AB_PRUNING);
+
+    // Reverse futility pruning: the opponent cannot make up the difference
+    if(frontier && PRUNING & REVERSE_FUTILITY_PRUNING &&
+       (turn ? staticScore - reverseFutilityMargin * ply >= beta :
+               staticScore + reverseFutilityMargin * ply <= alpha)) {
+        finalMoveInfo.leaves = 1;
+        finalMoveInfo.score = turn ? beta : alpha;
+        return finalMoveInfo;
+    }
+
+    // Razoring: far below the window, only captures can help
+    if(frontier && PRUNING & RAZORING &&
+       (turn ? staticScore + razorMargin * ply <= alpha :
+               staticScore - razorMargin * ply >= beta)) {
+        temp = SEARCH_NAME(quiescence)(thread, curState, 0, height,
+                          turn ? alpha : beta - MIN_WINDOW, turn ? alpha + MIN_WINDOW : beta);
+        if(ply == 1 || (turn ? temp.score <= alpha : temp.score >= beta)) {
+            return temp;
+        }
+        finalMoveInfo.leaves += temp.leaves;
+        thread->pvLength[height] = height;
+    }
+
+    // Futility pruning: quiet moves cannot raise the score to the window
+    futile = frontier && PRUNING & FUTILITY_PRUNING &&
+             (turn ? staticScore + futilityMargin * ply <= alpha :
+                     staticScore - futilityMargin * ply >= beta);
+
+    /* Null move pruning: if passing still fails high at reduced depth,
+     * a real move would too. The null move is never the best move, so it
+     * is not tried at the root. Positions with only pawns (and the king)
+     * are skipped since zugzwang is common there.
+     */
+    if((PRUNING & (NULL_PRUNING | AB_PRUNING)) == (NULL_PRUNING | AB_PRUNING) &&
+       height > 0 && height >= thread->nullMinHeight && !thread->followPV &&
+       thread->currentMove[height - 1] != NULL_MOVE &&
+       (turn ? staticScore >= beta : staticScore <= alpha) &&
+       hasNonPawnMaterial(curState, turn) && !inCheck) {
+        R = 3 + ply / 4 + (int) fmin((turn ? staticScore - beta : alpha - staticScore) /
+                                     (2 * fabs(pieceValues[W_PAWN])), 3);
+        thread->currentMove[height] = NULL_MOVE;
+        nextState = pushMove(curState, NULL_MOVE);
+        temp = SEARCH_NAME(miniMax)(thread, &nextState, ply - 1 - R, height + 1,
+                       turn ? beta - MIN_WINDOW : alpha, turn ? beta : alpha + MIN_WINDOW);
+        finalMoveInfo.leaves += temp.leaves;
+
+        if(turn ? temp.score >= beta : temp.score <= alpha) {
+            // At high depths, verify with a reduced search that doesn't pass
+            if(ply >= nullMoveVerifyDepth) {
+                nullMinHeight = thread->nullMinHeight;
+                thread->nullMinHeight = height + 3 * (ply - R) / 4;
+                temp = SEARCH_NAME(miniMax)(thread, curState, ply - R, height,
+                               turn ? beta - MIN_WINDOW : alpha, turn ? beta : alpha + MIN_WINDOW);
+                thread->nullMinHeight = nullMinHeight;
+                thread->pvLength[height] = height;
+                finalMoveInfo.leaves += temp.leaves;
+            }
+            // Mate scores from a null move search are not proven
+            if(turn ? temp.score >= beta : temp.score <= alpha) {
+                finalMoveInfo.score = turn ? beta : alpha;
+                return finalMoveInfo;
+            }
+        }
+    }
+
+    scoreMoves(thread, curState, height, legalMoves, scores, numMoves, pvMove);
+    if(PRUNING & FORWARD_PRUNING) {
+        // After the principal variation, order by the evaluation after each move
+        for(i=0; i<numMoves; i++) {
+            if(legalMoves[i] != pvMove) {
+                nextState = pushMove(curState, legalMoves[i]);
+                childScore = EVALUATE(&nextState, -INFINITY, INFINITY);
+                scores[i] = turn ? childScore : -childScore;
+            }
+        }
+    }
+
+    stop = (PRUNING & FORWARD_PRUNING) && forwardPruneN < numMoves ? forwardPruneN : numMoves;
+    for(i=0; i<stop; i++) {
+        pickMove(legalMoves, scores, numMoves, i);
+
+        nextState = pushMove(curState, legalMoves[i]);
+        givesCheck = turn ? bInCheck(&nextState) : wInCheck(&nextState);
+        quiet = isQuiet(legalMoves[i]) && !givesCheck && !inCheck &&
+                legalMoves[i] != thread->killers[height][0] &&
+                legalMoves[i] != thread->killers[height][1];
+
+        if(futile && quiet && i > 0) {
+            continue;
+        }
+
+        // Late move pruning: skip quiet moves late in the list near the horizon
+        if(PRUNING & LATE_MOVE_PRUNING && quiet && ply <= 3 && i >= 3 + ply * ply &&
+           bestMove != -1 && !isMateScore(turn ? alpha : beta)) {
+            continue;
+        }
+
+        // get score from recursive call
+        thread->currentMove[height] = legalMoves[i];
+        newPly = ply - 1;
+        if((PRUNING & (LATE_MOVE_REDUCTIONS | AB_PRUNING)) ==
+                (LATE_MOVE_REDUCTIONS | AB_PRUNING) &&
+           ply >= 3 && i >= 3 && (quiet || (!givesCheck && !inCheck &&
+                isCapture(legalMoves[i]) && !seeGE(curState, legalMoves[i], 0)))) {
+            // Late move reductions: test the bound at reduced depth first
+            newPly -= LMR_TABLE[ply < 64 ? ply : 63][i < 64 ? i : 63];
+            if(newPly < 1) {
+                newPly = 1;
+            }
+        }
+        if(newPly < ply - 1) {
+            temp = SEARCH_NAME(miniMax)(thread, &nextState, newPly, height + 1,
+                           turn ? alpha : beta - MIN_WINDOW, turn ? alpha + MIN_WINDOW : beta);
+            finalMoveInfo.leaves += temp.leaves;
+            if(turn ? temp.score > alpha : temp.score < beta) {
+                // Re-search at full depth on a fail high
+                temp = SEARCH_NAME(miniMax)(thread, &nextState, ply - 1, height + 1, alpha, beta);
+                finalMoveInfo.leaves += temp.leaves;
+            }
+        } else {
+            temp = SEARCH_NAME(miniMax)(thread, &nextState, ply - 1, height + 1, alpha, beta);
+            finalMoveInfo.leaves += temp.leaves;
+        }
+        // Only the first move can continue the previous principal variation
+        thread->followPV = 0;
+
+        if(turn) {
+            if(temp.score > alpha) {
+                alpha = temp.score;
+                bestMove = legalMoves[i];
+                updatePV(thread, height, bestMove);
+            }
+        } else if(temp.score < beta) {
+            beta = temp.score;
+            bestMove = legalMoves[i];
+            updatePV(thread, height, bestMove);
+        }
+
+        if((PRUNING & AB_PRUNING) && beta <= alpha) {
+            // Remember quiet moves that cause a cutoff
+            if(isQuiet(bestMove)) {
+                if(thread->killers[height][0] != bestMove) {
+                    thread->killers[height][1] = thread->killers[height][0];
+                    thread->killers[height][0] = bestMove;
+                }
+                thread->history[getMovedPiece(bestMove)][getDestination(bestMove)] += ply * ply;
+            }
+            finalMoveInfo.move = bestMove;
+            finalMoveInfo.score = turn ? alpha : beta;
+            return finalMoveInfo;
+        }
+     }
+
+    finalMoveInfo.move = bestMove;
+    finalMoveInfo.score = turn ? alpha : beta;
+    return finalMoveInfo;
+}
+
+static moveScoreLeaves SEARCH_NAME(quiescence)(SearchThread *thread, const GameState *curState,
+                                               int qply, int height, double alpha, double beta) {
+    double standPat = 0, gain, scores[MAX_MOVES];
+    int numMoves, n, i, turn, inCheck;
+    Move moves[MAX_MOVES], m;
+    GameState nextState;
+    moveScoreLeaves finalMoveInfo, temp;
+
+    pthread_testcancel();
+    thread->pvLength[height] = height;
+    turn = getTurn(*curState);
+    inCheck = turn ? wInCheck(curState) : bInCheck(curState);
+    finalMoveInfo.leaves = 0;
+
+    if(inCheck) {
+        // Every evasion is searched, so checkmate can be found
+        generateLegalMoves(curState, moves, &numMoves);
+        if(numMoves == 0) {
+            finalMoveInfo.leaves = 1;
+            finalMoveInfo.score = turn ? height - MATE_SCORE : MATE_SCORE - height;
+            return finalMoveInfo;
+        }
+        for(i=0; i<numMoves; i++) {
+            scores[i] = captureOrderScore(moves[i]);
+        }
+    } else {
+        standPat = EVALUATE(curState, alpha, beta);
+        if(turn) {
+            if(standPat >= beta) {
+                finalMoveInfo.leaves = 1;
+                finalMoveInfo.score = standPat;
+                return finalMoveInfo;
+            }
+            if(standPat > alpha) {
+                alpha = standPat;
+            }
+        } else {
+            if(standPat <= alpha) {
+                finalMoveInfo.leaves = 1;
+                finalMoveInfo.score = standPat;
+                return finalMoveInfo;
+            }
+            if(standPat < beta) {
+                beta = standPat;
+            }
+        }
+
+        // Only captures of the opponent and queen promotions are searched
+        generatePseudoLegalMoves(curState, moves, &n);
+        for(i=numMoves=0; i<n; i++) {
+            m = moves[i];
+            if(isPromotion(m) ? getPromotionPiece(m) % 6 != W_QUEEN :
+               getCapturedPiece(m) == NUM_PIECES) {
+                continue;
+            }
+            if(getCapturedPiece(m) != NUM_PIECES &&
+               getCapturedPiece(m) / 6 == getMovedPiece(m) / 6) {
+                continue;
+            }
+            moves[numMoves] = m;
+            scores[numMoves++] = captureOrderScore(m);
+        }
+    }
+
+    if(height >= MAX_PLY - 1 || qply >= quiescenceMaxDepth) {
+        finalMoveInfo.leaves = 1;
+        finalMoveInfo.score = inCheck ? EVALUATE(curState, alpha, beta) : standPat;
+        return finalMoveInfo;
+    }
+
+    for(i=0; i<numMoves; i++) {
+        pickMove(moves, scores, numMoves, i);
+        m = moves[i];
+
+        if(!inCheck) {
+            // Delta pruning: even winning the piece cannot raise the score
+            gain = fabs(pieceValues[getCapturedPiece(m)]) + deltaMargin;
+            if(isPromotion(m)) {
+                gain += fabs(pieceValues[getPromotionPiece(m)]) -
+                        fabs(pieceValues[W_PAWN]);
+            }
+            if(turn ? standPat + gain <= alpha : standPat - gain >= beta) {
+                continue;
+            }
+
+            // Captures which lose material in the exchange
+            if(!seeGE(curState, m, 0)) {
+                continue;
+            }
+
+            nextState = pushMove(curState, m);
+            if(turn ? wInCheck(&nextState) : bInCheck(&nextState)) {
+                continue;  // illegal
+            }
+        } else {
+            nextState = pushMove(curState, m);
+        }
+
+        temp = SEARCH_NAME(quiescence)(thread, &nextState, qply + 1, height + 1, alpha, beta);
+        finalMoveInfo.leaves += temp.leaves;
+
+        if(turn) {
+            if(temp.score > alpha) {
+                alpha = temp.score;
+                updatePV(thread, height, m);
+            }
+        } else if(temp.score < beta) {
+            beta = temp.score;
+            updatePV(thread, height, m);
+        }
+
+        if(beta <= alpha) {
+            break;
+        }
+    }
+
+    if(!finalMoveInfo.leaves) {
+        finalMoveInfo.leaves = 1;
+    }
+    finalMoveInfo.score = turn ? alpha : beta;
+    return finalMoveInfo;
+}
+
+#undef SEARCH_NAME
+#undef PRUNING
+#undef STRATEGY
@@ -0,0 +1,168 @@
+/**
+ * see.c contains implementation for the functions and constants
+ * defined in the associated header file.
+ * @author Blake Herrera
+ * @date 2023-04-26
+ * @see see.h
+ */
+
+#include "see.h"
+#include "bitboard.h"
+#include "config.h"
+#include "magic.h"
+#include "move.h"
+#include "movegen.h"
+#include "piece.h"
+#include "position.h"
+
+#include <math.h>
+
+#define value(piece) fabs(pieceValues[piece])
+
+/**
+ * Private function.
+ * Finds the least valuable piece of one color in a set of attackers.
+ * @param state - Pointer to the current game state.
+ * @param attackers - The attacking pieces of both colors.
+ * @param white - TRUE to find a white piece. FALSE for black.
+ * @param piece - Output for the piece type found.
+ * @return The attacker's square as a bitmask, or 0 if there is none.
+ */
+static bitmask leastValuableAttacker(const GameState *state, bitmask attackers,
+                                     int white, int *piece) {
+    int p, last = white ? W_KING : B_KING;
+    bitmask bm;
+    for(p=last-5; p<=last; p++) {
+        bm = attackers & state->bb[p];
+        if(bm) {
+            *piece = p;
+            return bm & -bm;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Private function.
+ * Adds sliding pieces revealed behind a removed attacker.
+ * @param state - Pointer to the current game state.
+ * @param sq - The square being exchanged on.
+ * @param occupancy - The occupied squares, less the removed attackers.
+ * @return The sliding pieces which now attack the square.
+ */
+static bitmask xrayAttackers(const GameState *state, Square sq, bitmask occupancy) {
+    return
+        (hashRook(sq, occupancy) & (
+            state->bb[W_ROOK] | state->bb[W_QUEEN] |
+            state->bb[B_ROOK] | state->bb[B_QUEEN])) |
+        (hashBishop(sq, occupancy) & (
+            state->bb[W_BISHOP] | state->bb[W_QUEEN] |
+            state->bb[B_BISHOP] | state->bb[B_QUEEN]));
+}
+
+double see(const GameState *state, Move m) {
+    double gain[32];
+    int d = 0, white, piece;
+    Square to = getDestination(m);
+    bitmask occupancy, attackers, from;
+
+    if(isCastling(m)) {
+        return 0;
+    }
+
+    white = getMovedPiece(m) < NUM_PIECES / 2;
+    occupancy = state->bb[BLOCKERS] ^ 1ULL << getSource(m);
+    if(isEP(m)) {
+        occupancy ^= 1ULL << (to + (white ? -8 : 8));
+    }
+    gain[0] = value(getCapturedPiece(m));
+    piece = getMovedPiece(m);
+    if(isPromotion(m)) {
+        gain[0] += value(getPromotionPiece(m)) - value(W_PAWN);
+        piece = getPromotionPiece(m);
+    }
+    attackers = getAttackersTo(state, to, occupancy) & occupancy;
+
+    // Swap list: gain[d] is the score if the exchange stops at depth d
+    do {
+        d++;
+        gain[d] = value(piece) - gain[d - 1];
+        white = !white;
+        from = leastValuableAttacker(state, attackers, white, &piece);
+        if(from && piece % 6 == W_KING &&
+           leastValuableAttacker(state, attackers & ~from, !white, &piece)) {
+            break;  // The king cannot capture into check
+        }
+        occupancy ^= from;
+        attackers = (attackers | xrayAttackers(state, to, occupancy)) & occupancy;
+    } while(from && d < 31);
+
+    while(--d) {
+        gain[d - 1] = -fmax(-gain[d - 1], gain[d]);
+    }
+    return gain[0];
+}
+
+int seeGE(const GameState *state, Move m, double margin) {
+    int white, piece, result = 1;
+    Square to = getDestination(m);
+    double swap;
+    bitmask occupancy, attackers, from;
+
+    if(isCastling(m)) {
+        return 0 >= margin;
+    }
+
+    white = getMovedPiece(m) < NUM_PIECES / 2;
+    piece = getMovedPiece(m);
+    swap = value(getCapturedPiece(m));
+    if(isPromotion(m)) {
+        swap += value(getPromotionPiece(m)) - value(W_PAWN);
+        piece = getPromotionPiece(m);
+    }
+
+    // Even winning the captured piece for free is not enough
+    swap -= margin;
+    if(swap < 0) {
+        return 0;
+    }
+    // Even losing the moved piece for nothing is enough
+    swap = value(piece) - swap;
+    if(swap <= 0) {
+        return 1;
+    }
+
+    occupancy = state->bb[BLOCKERS] & ~(1ULL << getSource(m) | 1ULL << to);
+    if(isEP(m)) {
+        occupancy ^= 1ULL << (to + (white ? -8 : 8));
+    }
+    attackers = getAttackersTo(state, to, occupancy);
+
+    /* result is TRUE if the side which made the move comes out ahead
+     * should the side to move now stop capturing, and swap is how far
+     * that side is past the margin.
+     */
+    while(1) {
+        white = !white;
+        attackers &= occupancy;
+        from = leastValuableAttacker(state, attackers, white, &piece);
+        if(!from) {
+            break;
+        }
+        if(piece % 6 == W_KING) {
+            // The king can only capture if the square is no longer defended
+            return leastValuableAttacker(state, attackers, !white, &piece) ?
+                result : !result;
+        }
+        result = !result;
+        swap = value(piece) - swap;
+        if(result ? swap <= 0 : swap < 0) {
+            break;
+        }
+        occupancy ^= from;
+        attackers |= xrayAttackers(state, to, occupancy);
+    }
+    return result;
+}
+
+#undef value
@@ -0,0 +1,38 @@
+/**
+ * see.h contains functions for static exchange evaluation (SEE), which
+ * finds the material won or lost by a sequence of captures on a single
+ * square, assuming both sides always recapture with their least valuable
+ * piece and may stop capturing at any time.
+ * @author Blake Herrera
+ * @date 2023-04-26
+ * @see https://www.chessprogramming.org/Static_Exchange_Evaluation
+ */
+
+#ifndef SEE_H_INCLUDED
+#define SEE_H_INCLUDED
+
+#include "move.h"
+#include "position.h"
+
+/**
+ * Finds the material gained by a move once all exchanges on its
+ * destination square are resolved. Pins are not considered.
+ * @param state - Pointer to the current game state.
+ * @param m - The move to evaluate.
+ * @return The material gained by the side to move, in pawns.
+ * Negative if the move loses material.
+ */
+double see(const GameState *state, Move m);
+
+/**
+ * Checks whether a move's static exchange evaluation is at least the
+ * given margin. This stops as soon as the outcome is known, so it is
+ * cheaper than comparing the result of see.
+ * @param state - Pointer to the current game state.
+ * @param m - The move to evaluate.
+ * @param margin - The material the move must gain, in pawns.
+ * @return TRUE if see(state, m) >= margin. FALSE otherwise.
+ */
+int seeGE(const GameState *state, Move m, double margin);
+
+#endif // SEE_H_INCLUDED
@@ -0,0 +1,450 @@
+/**
+ * tune.c contains implementation for the functions and constants
+ * defined in the associated header file.
+ * @author Blake Herrera
+ * @date 2023-04-30
+ * @see tune.h
+ */
+
+#include "tune.h"
+#include "config.h"
+#include "dataset.h"
+#include "error.h"
+#include "evaluate.h"
+#include "filemap.h"
+#include "move.h"
+#include "movegen.h"
+#include "position.h"
+#include "search.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Longer lines in a data file are cut off
+#define MAX_LINE_LENGTH 256
+
+/* The local search tries moving each parameter by a step, and halves the
+ * step once no parameter improves, down to MIN_STEP. Steps are in pawns.
+ */
+#define INITIAL_STEP 0.1
+#define MIN_STEP 0.005
+
+// Positions of a packed data file are read this many at a time
+#define DATASET_CHUNK_SIZE 4096
+
+// Range of the scaling constant for the win probability
+#define MIN_K 0.01
+#define MAX_K 10.0
+
+/* A tunable parameter is one or more doubles. For pieceValues these are
+ * the white pieces', and the black pieces' are kept as their negatives.
+ */
+typedef struct Parameter {
+    const char *szName;
+    double *values;
+    int count;
+} Parameter;
+
+static const Parameter PARAMETERS[] = {
+    {"pieceValues", pieceValues, 5},
+    {"mobilityFactor", &mobilityFactor, 1},
+    {"safeMobilityWeight", &safeMobilityWeight, 1},
+    {"kingAttackWeight", &kingAttackWeight, 1},
+    {"hangingPieceWeight", &hangingPieceWeight, 1},
+    {"passedPawnWeight", &passedPawnWeight, 1},
+    {"isolatedPawnWeight", &isolatedPawnWeight, 1},
+    {"doubledPawnWeight", &doubledPawnWeight, 1},
+    {"backwardPawnWeight", &backwardPawnWeight, 1},
+    {"pawnShieldWeight", &pawnShieldWeight, 1}
+};
+#define NUM_PARAMETERS ((int) (sizeof(PARAMETERS) / sizeof(PARAMETERS[0])))
+
+// The training positions, resolved to quiet ones, their results and their latest scores
+static PackedPosition *positions;
+static double *results, *scores;
+static long numPositions;
+
+/* Where the resolving threads read the positions from: a mapped text
+ * data file, or otherwise a dataset of packed positions. Each position's
+ * index is its line or record in the file, and keep is TRUE for those
+ * which were read and resolved.
+ */
+static const char *textData;
+static size_t textSize;
+static PackedDataset dataset;
+static atomic_size_t chunksTaken;
+static char *keep;
+
+// The lines of the text data file read by one resolving thread
+typedef struct ResolveSlice {
+    size_t start, end;
+    long index;
+} ResolveSlice;
+
+/**
+ * Private function.
+ * Reads a game result from a line of a data file.
+ * @param szLine - The line to read.
+ * @param result - Output for the result, from white's perspective.
+ * @return TRUE if the line has a result. FALSE otherwise.
+ */
+static int parseResult(const char *szLine, double *result) {
+    const char *szBracket;
+    if(strstr(szLine, "1/2-1/2") != NULL) {
+        *result = 0.5;
+    } else if(strstr(szLine, "1-0") != NULL) {
+        *result = 1;
+    } else if(strstr(szLine, "0-1") != NULL) {
+        *result = 0;
+    } else if((szBracket = strchr(szLine, '[')) != NULL) {
+        *result = atof(szBracket + 1);
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Private function.
+ * Gets the start of the line after the one starting at an offset of the
+ * text data file.
+ * @param offset - The offset of the line.
+ * @return The offset of the next line, or the size of the file.
+ */
+static size_t nextLine(size_t offset) {
+    const char *szNewline = memchr(textData + offset, '\n', textSize - offset);
+    return szNewline == NULL ? textSize : (size_t) (szNewline - textData) + 1;
+}
+
+/**
+ * Private function.
+ * Opens a data file for the resolving threads, and makes room for one
+ * position per line or record. Files ending in .bin are read as
+ * PackedPositions.
+ * @param szPath - The path of the data file.
+ * @return 0 on success. Nonzero if the file could not be read.
+ */
+static int openData(const char *szPath) {
+    size_t length = strlen(szPath), offset;
+
+    textData = NULL;
+    if(length >= 4 && !strcmp(szPath + length - 4, ".bin")) {
+        if(openDataset(&dataset, szPath, DATASET_CHUNK_SIZE, clock())) {
+            return 1;
+        }
+        numPositions = dataset.numPositions;
+    } else {
+        textData = mapFile(szPath, &textSize);
+        if(textData == NULL) {
+            return 1;
+        }
+        for(offset=0, numPositions=0; offset<textSize; offset=nextLine(offset)) {
+            numPositions++;
+        }
+    }
+    positions = malloc(numPositions * sizeof(PackedPosition));
+    results = malloc(numPositions * sizeof(double));
+    keep = calloc(numPositions, sizeof(char));
+    errTrap(positions == NULL || results == NULL || keep == NULL,
+            "Error on malloc in openData\n");
+    return 0;
+}
+
+/**
+ * Private function.
+ * Replaces a position with the end of the principal variation of a
+ * quiescence search from it, so that it is quiet, and packs it. Positions
+ * found to be checkmate are not kept.
+ * @param thread - The resolving thread's search data.
+ * @param state - The position.
+ * @param index - The index of the position.
+ * @param result - The game result, from white's perspective.
+ */
+static void resolvePosition(SearchThread *thread, const GameState *state,
+                            long index, double result) {
+    GameState leaf = *state;
+    moveScoreLeaves msl;
+    int i;
+
+    initSearchThread(thread);
+    msl = quiescence(thread, state, 0, 0, -INFINITY, INFINITY);
+    if(isMateScore(msl.score)) {
+        return;
+    }
+    for(i=0; i<thread->pvLength[0]; i++) {
+        leaf = pushMove(&leaf, thread->pv[0][i]);
+    }
+    packPosition(&leaf, &positions[index]);
+    results[index] = result;
+    keep[index] = 1;
+}
+
+/**
+ * Private function.
+ * Reads and resolves positions from the data file, a line at a time
+ * from the slice of a text file, or otherwise a chunk at a time from the
+ * dataset until a pass over it is done. Runs in its own thread.
+ * @param params - Pointer to the ResolveSlice.
+ * @return NULL
+ */
+static void *resolveSlice(void *params) {
+    const ResolveSlice *slice = params;
+    SearchThread *thread = malloc(sizeof(SearchThread));
+    const PackedPosition *packed;
+    DatasetChunk chunk;
+    GameState state;
+    char szLine[MAX_LINE_LENGTH];
+    size_t start, end, length, i;
+    long index;
+    double result;
+
+    errTrap(thread == NULL, "Error on malloc in resolveSlice\n");
+    if(textData != NULL) {
+        for(start=slice->start, index=slice->index; start<slice->end; start=end, index++) {
+            end = nextLine(start);
+            length = end - start < MAX_LINE_LENGTH ? end - start : MAX_LINE_LENGTH - 1;
+            memcpy(szLine, textData + start, length);
+            szLine[length] = '\0';
+            if(parseResult(szLine, &result) && positionFromFenLine(szLine, &state)) {
+                resolvePosition(thread, &state, index, result);
+            }
+        }
+    } else {
+        // Only as many chunks as one pass has are taken
+        while(atomic_fetch_add(&chunksTaken, 1) < dataset.numChunks &&
+              nextDatasetChunk(&dataset, &chunk)) {
+            for(i=0; i<chunk.n; i++) {
+                packed = chunkPosition(&chunk, i);
+                state = unpackPosition(packed);
+                resolvePosition(thread, &state, packed - dataset.positions,
+                                (packed->result + 1) / 2.0);
+            }
+        }
+    }
+    free(thread);
+    return NULL;
+}
+
+/**
+ * Private function.
+ * Reads and resolves every position of the data file on numThreads
+ * threads, then drops those which could not be read or are checkmate and
+ * closes the file.
+ */
+static void resolvePositions() {
+    int i, threads = numThreads < 1 ? 1 : numThreads;
+    long j, line;
+    size_t offset;
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    ResolveSlice *slices = malloc(threads * sizeof(ResolveSlice));
+
+    errTrap(workers == NULL || slices == NULL, "Error on malloc in resolvePositions\n");
+    atomic_store(&chunksTaken, 0);
+    for(i=line=offset=0; i<threads; i++) {
+        // Each thread gets as many lines of a text file as it can
+        slices[i].start = offset;
+        slices[i].index = line;
+        for(; textData != NULL && line < numPositions * (i + 1) / threads; line++) {
+            offset = nextLine(offset);
+        }
+        slices[i].end = offset;
+        errTrap(pthread_create(&workers[i], NULL, resolveSlice, &slices[i]),
+                "Error on pthread_create in resolvePositions\n");
+    }
+    for(i=0; i<threads; i++) {
+        errTrap(pthread_join(workers[i], NULL),
+                "Error on pthread_join in resolvePositions\n");
+    }
+
+    for(line=j=0; line<numPositions; line++) {
+        if(keep[line]) {
+            positions[j] = positions[line];
+            results[j++] = results[line];
+        }
+    }
+    numPositions = j;
+    if(textData != NULL) {
+        unmapFile(textData, textSize);
+    } else {
+        closeDataset(&dataset);
+    }
+    free(workers);
+    free(slices);
+    free(keep);
+}
+
+/**
+ * Private function.
+ * Gets the mean squared difference between the results and the win
+ * probabilities predicted from the latest scores.
+ * @param k - The scaling constant for the win probability.
+ * @return The mean squared error.
+ */
+static double scoreError(double k) {
+    long i;
+    double error = 0, difference;
+    for(i=0; i<numPositions; i++) {
+        difference = results[i] - 1 / (1 + pow(10, -k * scores[i] / 4));
+        error += difference * difference;
+    }
+    return error / numPositions;
+}
+
+/**
+ * Private function.
+ * Evaluates every position with the current parameters, then gets
+ * the mean squared error.
+ * @param k - The scaling constant for the win probability.
+ * @return The mean squared error.
+ */
+static double evaluationError(double k) {
+    evaluatePackedBatch(positions, numPositions, scores);
+    return scoreError(k);
+}
+
+/**
+ * Private function.
+ * Finds the scaling constant which best fits the current scores to the
+ * results, with a golden section search.
+ * @return The scaling constant.
+ */
+static double fitK() {
+    const double ratio = (sqrt(5) - 1) / 2;
+    double a = MIN_K, b = MAX_K, c, d;
+    while(b - a > 1e-4) {
+        c = b - ratio * (b - a);
+        d = a + ratio * (b - a);
+        if(scoreError(c) < scoreError(d)) {
+            b = d;
+        } else {
+            a = c;
+        }
+    }
+    return (a + b) / 2;
+}
+
+/**
+ * Private function.
+ * Sets one value of a parameter. Setting a piece value also sets the
+ * black piece's value. The material of each position is found again as
+ * it is unpacked.
+ * @param parameter - The parameter to set.
+ * @param i - The index of the value within the parameter.
+ * @param value - The new value.
+ */
+static void setParameter(const Parameter *parameter, int i, double value) {
+    parameter->values[i] = value;
+    if(parameter->values == pieceValues) {
+        pieceValues[i + NUM_PIECES / 2] = -value;
+    }
+}
+
+int tune(const char *szDataPath, const char *szOutputPath) {
+    int i, j, direction, improved;
+    double k, step, bestError, error, original;
+    const Parameter *parameter;
+
+    if(openData(szDataPath)) {
+        fprintf(stderr, "Could not read tuning data %s\n", szDataPath);
+        return 1;
+    }
+    printf("Read %ld lines or records\n", numPositions);
+    resolvePositions();
+    if(numPositions == 0) {
+        fprintf(stderr, "No positions to tune with\n");
+        return 1;
+    }
+    scores = malloc(numPositions * sizeof(double));
+    errTrap(scores == NULL, "Error on malloc in tune\n");
+
+    evaluatePackedBatch(positions, numPositions, scores);
+    k = fitK();
+    bestError = scoreError(k);
+    printf("Tuning with %ld quiet positions, K %.4f, error %.6f\n", numPositions, k, bestError);
+
+    for(step=INITIAL_STEP; step>=MIN_STEP; step/=2) {
+        do {
+            improved = 0;
+            for(i=0; i<NUM_PARAMETERS; i++) {
+                parameter = &PARAMETERS[i];
+                // The pawn is the unit of the other values, so it stays fixed
+                for(j=parameter->values == pieceValues; j<parameter->count; j++) {
+                    original = parameter->values[j];
+                    for(direction=1; direction>=-1; direction-=2) {
+                        setParameter(parameter, j, original + direction * step);
+                        error = evaluationError(k);
+                        if(error < bestError) {
+                            bestError = error;
+                            improved = 1;
+                            break;
+                        }
+                        setParameter(parameter, j, original);
+                    }
+                }
+            }
+            printf("Step %.4f error %.6f\n", step, bestError);
+            fflush(stdout);
+            if(saveParameters(szOutputPath)) {
+                fprintf(stderr, "Could not write parameters to %s\n", szOutputPath);
+                return 1;
+            }
+        } while(improved);
+    }
+
+    free(positions);
+    free(results);
+    free(scores);
+    return 0;
+}
+
+int loadParameters(const char *szPath) {
+    FILE *file = fopen(szPath, "r");
+    char szLine[MAX_LINE_LENGTH], *token;
+    int i, j, status = 0;
+
+    if(file == NULL) {
+        return 1;
+    }
+    while(fgets(szLine, sizeof(szLine), file) != NULL) {
+        token = strtok(szLine, " \t\r\n");
+        if(token == NULL || token[0] == '#') {
+            continue;
+        }
+        for(i=0; i<NUM_PARAMETERS && strcmp(token, PARAMETERS[i].szName); i++) {}
+        if(i == NUM_PARAMETERS) {
+            status = 1;
+            continue;
+        }
+        for(j=0; j<PARAMETERS[i].count && (token = strtok(NULL, " \t\r\n")) != NULL; j++) {
+            PARAMETERS[i].values[j] = atof(token);
+            if(PARAMETERS[i].values == pieceValues) {
+                pieceValues[j + NUM_PIECES / 2] = -pieceValues[j];
+            }
+        }
+    }
+    fclose(file);
+    return status;
+}
+
+int saveParameters(const char *szPath) {
+    FILE *file = fopen(szPath, "w");
+    int i, j;
+
+    if(file == NULL) {
+        return 1;
+    }
+    fprintf(file, "# Evaluation parameters, in pawns\n");
+    for(i=0; i<NUM_PARAMETERS; i++) {
+        fprintf(file, "%s", PARAMETERS[i].szName);
+        for(j=0; j<PARAMETERS[i].count; j++) {
+            fprintf(file, " %.4f", PARAMETERS[i].values[j]);
+        }
+        fprintf(file, "\n");
+    }
+    return fclose(file) != 0;
+}
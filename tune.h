@@ -0,0 +1,51 @@
+/**
+ * tune.h contains Texel tuning of the evaluation parameters: the piece
+ * values and the weights of the evaluation terms are fit to the results
+ * of games, by minimizing the squared difference between each result and
+ * the win probability predicted from the evaluation of a position from
+ * the game. Positions are resolved with a quiescence search first, so
+ * that only quiet positions are evaluated.
+ * @author Blake Herrera
+ * @date 2023-04-30
+ * @see https://www.chessprogramming.org/Texel%27s_Tuning_Method
+ */
+
+#ifndef TUNE_H_INCLUDED
+#define TUNE_H_INCLUDED
+
+/**
+ * Tunes the parameters of the selected evaluation with a local search,
+ * writing them to a parameter file after every pass. Each line of the
+ * data file is a FEN, which may leave off the move counters, followed
+ * by the game result from white's perspective as 1-0, 0-1 or 1/2-1/2,
+ * or as a number in brackets, like [0.5]. Lines without both are
+ * skipped. A data file ending in .bin is instead read as PackedPositions,
+ * like those written by generateTrainingData. The quiescence search and
+ * the evaluations run on numThreads threads, and the resolved positions
+ * are kept packed.
+ * @param szDataPath - The path of the data file.
+ * @param szOutputPath - The path to write the parameters to.
+ * @return 0 on success. Nonzero if the data could not be read or the
+ * parameters could not be written.
+ */
+int tune(const char *szDataPath, const char *szOutputPath);
+
+/**
+ * Loads a parameter file written by tune. Each line holds a parameter's
+ * name followed by its value, or for pieceValues the values of a pawn,
+ * knight, bishop, rook and queen. Lines starting with # are comments.
+ * Positions set up afterward use the loaded piece values.
+ * @param szPath - The path of the parameter file.
+ * @return 0 on success. Nonzero if the file could not be read or has a
+ * parameter that isn't known.
+ */
+int loadParameters(const char *szPath);
+
+/**
+ * Writes the tunable parameters to a file which loadParameters can read.
+ * @param szPath - The path of the parameter file.
+ * @return 0 on success. Nonzero if the file could not be written.
+ */
+int saveParameters(const char *szPath);
+
+#endif // TUNE_H_INCLUDED
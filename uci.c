@@ -17,6 +17,8 @@
 #include <signal.h>
 
 #include "bitboard.h"
+#include "book.h"
+#include "bitbase.h"
 #include "debug.h"
 #include "move.h"
 #include "movegen.h"
@@ -27,6 +29,7 @@
 #include "search.h"
 #include "evaluate.h"
 #include "config.h"
+#include "tune.h"
 #include "error.h"
 
 #ifdef _WIN32
@@ -49,11 +52,15 @@
 
 // From config.h
 int searchStrategy, pruning, evaluation, forwardPruneN, numThreads,
-    maxSearchDepth, quiescenceMaxDepth;
+    maxSearchDepth, quiescenceMaxDepth, nullMoveVerifyDepth, ownBook;
 double pieceValues[NUM_PIECES + 1], mobilityFactor, timeUseFraction,
-       quiescenceCutoff;
-double (*evaluationFunction)(GameState);
-double (*evaluationFunctions[3])(GameState);
+       deltaMargin, futilityMargin, reverseFutilityMargin, razorMargin,
+       lazyEvalMargin,
+       safeMobilityWeight, kingAttackWeight, hangingPieceWeight,
+       passedPawnWeight, isolatedPawnWeight, doubledPawnWeight,
+       backwardPawnWeight, pawnShieldWeight;
+double (*evaluationFunction)(const GameState*);
+double (*evaluationFunctions[NUM_EVALUATION_FUNCS])(const GameState*);
 
 // UCI specific
 static char szBuffer[6000 * 6];
@@ -62,6 +69,7 @@ static int wTime, bTime, wInc, bInc, movesToGo, isReady;
 
 // Thread and shared data management
 static Move principalVariation;
+static SearchThread searchThread;
 static pthread_t timeKeeper, searchMaster;
 static pthread_mutex_t manageThreads;
 static pthread_cond_t readyToSubmit;
@@ -109,17 +117,36 @@ void uciCommunicate() {
 
 void uciBoot() {
     printf("id name %s v%s\nid author %s\n\n"
-           "option name searchStrategy type spin default 1 min 0 max 2\n"
-           "option name pruning type spin default 1 min 0 max 7\n"
-           "option name evaluation type spin default 0 min 0 max 2\n"
+           "option name searchStrategy type spin default %d min 0 max 2\n"
+           "option name pruning type spin default %d min 0 max 511\n"
+           "option name evaluation type spin default 0 min 0 max 6\n"
            "option name maxSearchDepth type spin default 99 min 1 max 99\n"
            "option name forwardPruneN type spin default 999 min 1 max 999\n"
            "option name numThreads type spin default 1 min 1 max 512\n"
            "option name mobilityFactor type double default 0.1 min 0 max 1\n"
            "option name timeUseFraction type double default 0.05 min 0.001 max 1.0\n"
-           "option name quiescenceCutoff type double default 1.0 min 0.001 max 200.0\n"
+           "option name quiescenceMaxDepth type spin default 10 min 0 max 64\n"
+           "option name deltaMargin type double default 2.0 min 0 max 200.0\n"
+           "option name nullMoveVerifyDepth type spin default 12 min 1 max 99\n"
+           "option name futilityMargin type double default 1.0 min 0 max 20.0\n"
+           "option name reverseFutilityMargin type double default 0.8 min 0 max 20.0\n"
+           "option name razorMargin type double default 3.0 min 0 max 20.0\n"
+           "option name lazyEvalMargin type double default 4.0 min 0 max 1000.0\n"
+           "option name safeMobilityWeight type double default 0.05 min 0 max 1\n"
+           "option name kingAttackWeight type double default 0.1 min 0 max 1\n"
+           "option name hangingPieceWeight type double default 0.3 min 0 max 10\n"
+           "option name passedPawnWeight type double default 0.1 min 0 max 1\n"
+           "option name isolatedPawnWeight type double default 0.15 min 0 max 1\n"
+           "option name doubledPawnWeight type double default 0.15 min 0 max 1\n"
+           "option name backwardPawnWeight type double default 0.1 min 0 max 1\n"
+           "option name pawnShieldWeight type double default 0.1 min 0 max 1\n"
+           "option name nnueFile type string default <empty>\n"
+           "option name paramFile type string default <empty>\n"
+           "option name OwnBook type check default false\n"
+           "option name BookFile type string default <empty>\n"
+           "option name bitbaseDir type string default <empty>\n"
            "option name pieceValues type double[12] default 1 3 3 5 9"
-           "uciok\n", ENGINE_NAME, VERSION, AUTHORS);
+           "uciok\n", ENGINE_NAME, VERSION, AUTHORS, PRODUCTION_STRATEGY, PRODUCTION_PRUNING);
 }
 
 void uciDebug() {
@@ -153,12 +180,18 @@ void uciSetOption() {
     } else if(is("searchStrategy")) {
         next();
         searchStrategy = nextInt();
+        selectSearch();
     } else if(is("pruning")) {
         next();
         pruning = nextInt();
+        selectSearch();
     } else if(is("evaluation")) {
         next();
-        evaluationFunction = evaluationFunctions[nextInt()];
+        evaluation = nextInt();
+        if(evaluation >= 0 && evaluation < NUM_EVALUATION_FUNCS) {
+            evaluationFunction = evaluationFunctions[evaluation];
+        }
+        selectSearch();
     } else if(is("numThreads")) {
         next();
         numThreads = nextInt();
@@ -171,12 +204,76 @@ void uciSetOption() {
     } else if(is("timeUseFraction")) {
         next();
         timeUseFraction = nextFloat();
-    } else if(is("quiescenceCutoff")) {
+    } else if(is("deltaMargin")) {
+        next();
+        deltaMargin = nextFloat();
+    } else if(is("futilityMargin")) {
+        next();
+        futilityMargin = nextFloat();
+    } else if(is("reverseFutilityMargin")) {
+        next();
+        reverseFutilityMargin = nextFloat();
+    } else if(is("razorMargin")) {
+        next();
+        razorMargin = nextFloat();
+    } else if(is("lazyEvalMargin")) {
+        next();
+        lazyEvalMargin = nextFloat();
+    } else if(is("safeMobilityWeight")) {
+        next();
+        safeMobilityWeight = nextFloat();
+    } else if(is("kingAttackWeight")) {
+        next();
+        kingAttackWeight = nextFloat();
+    } else if(is("hangingPieceWeight")) {
+        next();
+        hangingPieceWeight = nextFloat();
+    } else if(is("passedPawnWeight")) {
+        next();
+        passedPawnWeight = nextFloat();
+    } else if(is("isolatedPawnWeight")) {
+        next();
+        isolatedPawnWeight = nextFloat();
+    } else if(is("doubledPawnWeight")) {
+        next();
+        doubledPawnWeight = nextFloat();
+    } else if(is("backwardPawnWeight")) {
+        next();
+        backwardPawnWeight = nextFloat();
+    } else if(is("pawnShieldWeight")) {
+        next();
+        pawnShieldWeight = nextFloat();
+    } else if(is("nnueFile")) {
+        next();
+        token = strtok(NULL, "");  // the path may contain spaces
+        if(token == NULL || nnueLoad(token)) {
+            printf("info string Could not load network %s\n", token ? token : "");
+        }
+    } else if(is("paramFile")) {
+        next();
+        token = strtok(NULL, "");
+        if(token == NULL || loadParameters(token)) {
+            printf("info string Could not load parameters %s\n", token ? token : "");
+        }
+    } else if(is("OwnBook")) {
         next();
-        quiescenceCutoff = nextFloat();
+        ownBook = !strcmp(next(), "true");
+    } else if(is("BookFile")) {
+        next();
+        token = strtok(NULL, "");
+        if(token == NULL || bookLoad(token)) {
+            printf("info string Could not load book %s\n", token ? token : "");
+        }
+    } else if(is("bitbaseDir")) {
+        next();
+        token = strtok(NULL, "");
+        printf("info string Loaded %d bitbases\n", token == NULL ? 0 : bitbaseLoad(token));
     } else if(is("quiescenceMaxDepth")) {
         next();
         quiescenceMaxDepth = nextInt();
+    } else if(is("nullMoveVerifyDepth")) {
+        next();
+        nullMoveVerifyDepth = nextInt();
     } else if(is("pieceValues")) {
         next();
         for(i=0; i<5; i++) {
@@ -243,8 +340,9 @@ void uciQuit() {
 }
 
 void uciGo() {
-    char *token;
+    char *token, szMoveString[6];
     int addSearchMoves = 0;
+    Move move;
     if(!isReady) {
         return;
     }
@@ -290,6 +388,12 @@ void uciGo() {
                 "Error on pthread_join timeKeeper in uciGo\n");
         timeKeeper = 0;
     }
+    // Book moves are played at once, without searching
+    if(ownBook && (move = bookMove(&state)) != NULL_MOVE) {
+        toLAN(move, szMoveString);
+        printf("bestmove %s\n", szMoveString);
+        return;
+    }
     errTrap(pthread_create(&timeKeeper, NULL, timeKeepStart, NULL),
             "Error on pthread_create timeKeeper\n");
 }
@@ -325,6 +429,11 @@ void *timeKeepStart(void *params) {
     if(r != 0 && r != ETIMEDOUT) {
         errTrap(r, "Error on pthread_cond_timedwait in timeKeepStart\n");
     }
+    /* Unlock before joining, since the search may be waiting to report an
+     * iteration and can't be cancelled until it has.
+     */
+    errTrap(pthread_mutex_unlock(&manageThreads),
+            "Error on pthread_mutex_unlock in timeKeepStart\n");
 
     // kill search, submit move on wake
     errTrap(pthread_cancel(searchMaster),
@@ -335,19 +444,23 @@ void *timeKeepStart(void *params) {
     printf("bestmove %s\n", szMoveString);
     errTrap(fflush(stdout),
             "Error on fflush in timeKeepStart\n");
-    errTrap(pthread_mutex_unlock(&manageThreads),
-            "Error on pthread_mutex_unlock in timeKeepStart\n");
     return NULL;
 }
 
 void *threadStartSearch(void *params) {
-    int i;
+    int i, j, k;
     moveScoreLeaves msp;
-    char temp[6];
+    char szPV[MAX_PLY * 6], szScore[sizeof("mate -2147483648")];
     clock_t start = clock();
     double seconds;
-    unsigned long nodesAccumulator = 0L;
-
+    unsigned long nodesAccumulator = 0L, evaluations;
+
+    /* The search can only be cancelled while it is searching past depth 1,
+     * so that there is always a searched move to play, and never while it
+     * holds manageThreads.
+     */
+    errTrap(pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL),
+            "Error on pthread_setcancelstate in threadStartSearch\n");
     switch(searchStrategy) {
     case RANDOM_MOVES:
         errTrap(pthread_mutex_lock(&manageThreads),
@@ -358,24 +471,50 @@ void *threadStartSearch(void *params) {
         break;
     case MINIMAX:
     case MINIMAX_QUIESCENCE:
+        initSearchThread(&searchThread);
         for(i=0; i<=maxSearchDepth; i++) {
-            msp = miniMax(state, i, -INFINITY, INFINITY, evaluationFunction(state));
+            if(i > 1) {
+                errTrap(pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL),
+                        "Error on pthread_setcancelstate in threadStartSearch\n");
+            }
+            startIteration(&searchThread);
+            msp = miniMax(&searchThread, &state, i, 0, -INFINITY, INFINITY);
+            errTrap(pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL),
+                    "Error on pthread_setcancelstate in threadStartSearch\n");
             seconds = (double)(clock() - start + 1) / CLOCKS_PER_SEC;
             nodesAccumulator += msp.leaves;
             errTrap(pthread_mutex_lock(&manageThreads),
                     "Error on pthread_mutex_lock in threadStartSearch (MINIMAX)\n");
-            if(!i) {
-                msp.move = getRandomMove(state);
+            if(!searchThread.pvLength[0]) {
+                searchThread.pv[0][0] = getRandomMove(state);
+                searchThread.pvLength[0] = 1;
+            }
+            principalVariation = searchThread.pv[0][0];
+            for(j=k=0; j<searchThread.pvLength[0]; j++) {
+                toLAN(searchThread.pv[0][j], szPV + k);
+                k += strlen(szPV + k);
+                szPV[k++] = ' ';
+            }
+            szPV[k - 1] = '\0';
+            if(isMateScore(msp.score)) {
+                snprintf(szScore, sizeof(szScore), "mate %d", (msp.score > 0 ? 1 : -1) *
+                         (int) (MATE_SCORE - fabs(msp.score) + 1) / 2);
+            } else {
+                snprintf(szScore, sizeof(szScore), "cp %d", (int) (msp.score * 100));
+            }
+            printf("info depth %d nodes %lu time %0.3f nps %d score %s pv %s\n",
+                   i, nodesAccumulator, seconds, (int)(nodesAccumulator / seconds), szScore, szPV);
+            evaluations = evalCacheHits + evalCacheMisses + lazyEvalSkips;
+            if(evaluations) {
+                printf("info string evalcache hits %lu misses %lu lazyskips %lu (%.1f%%)\n",
+                       evalCacheHits, evalCacheMisses, lazyEvalSkips,
+                       100.0 * lazyEvalSkips / evaluations);
             }
-            principalVariation = msp.move;
-            toLAN(principalVariation, temp);
-            printf("info depth %d nodes %lu time %0.3f nps %d score cp %d pv %s\n",
-                   i, nodesAccumulator, seconds, (int)(nodesAccumulator / seconds), (int)(msp.score * 100), temp);
             errTrap(fflush(stdout),
                     "Error in fflush stdout in threadStartSearch\n");
             errTrap(pthread_mutex_unlock(&manageThreads),
                     "Error on pthread_mutex_unlock in threadStartSearch (MINIMAX)\n");
-            if(msp.score == DBL_MAX || msp.score == -DBL_MAX) {
+            if(isMateScore(msp.score)) {
                 break;
             }
         }
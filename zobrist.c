@@ -0,0 +1,72 @@
+/**
+ * zobrist.c contains implementation for the functions and constants
+ * defined in the associated header file.
+ * @author Blake Herrera
+ * @date 2023-04-28
+ * @see zobrist.h
+ */
+
+#include "zobrist.h"
+#include "bitboard.h"
+#include "piece.h"
+#include "position.h"
+#include "square.h"
+
+bitmask ZOBRIST_PIECES[NUM_PIECES + 1][NUM_SQUARES],
+        ZOBRIST_CASTLING[16],
+        ZOBRIST_EP[8],
+        ZOBRIST_TURN;
+
+/**
+ * Private function.
+ * Returns the next number from a xorshift64* generator.
+ * @param seed - Pointer to the generator's state, which must not be 0.
+ * @return A pseudo-random 64 bit number.
+ */
+static bitmask nextRandom(bitmask *seed) {
+    *seed ^= *seed >> 12;
+    *seed ^= *seed << 25;
+    *seed ^= *seed >> 27;
+    return *seed * 2685821657736338717ULL;
+}
+
+void zobristInit() {
+    int i, j;
+    bitmask seed = 1070372ULL;
+    for(i=0; i<NUM_PIECES; i++) {
+        for(j=0; j<NUM_SQUARES; j++) {
+            ZOBRIST_PIECES[i][j] = nextRandom(&seed);
+        }
+    }
+    for(j=0; j<NUM_SQUARES; j++) {
+        ZOBRIST_PIECES[NUM_PIECES][j] = 0ULL;
+    }
+    for(i=0; i<16; i++) {
+        ZOBRIST_CASTLING[i] = nextRandom(&seed);
+    }
+    for(i=0; i<8; i++) {
+        ZOBRIST_EP[i] = nextRandom(&seed);
+    }
+    ZOBRIST_TURN = nextRandom(&seed);
+}
+
+void setZobristKeys(GameState *state) {
+    int i;
+    bitmask bm;
+    state->key = state->pawnKey = 0ULL;
+    for(i=0; i<NUM_PIECES; i++) {
+        for(bm = state->bb[i]; bm; bm &= bm - 1) {
+            state->key ^= ZOBRIST_PIECES[i][LSB(bm) - 1];
+            if(i == W_PAWN || i == B_PAWN) {
+                state->pawnKey ^= ZOBRIST_PIECES[i][LSB(bm) - 1];
+            }
+        }
+    }
+    state->key ^= ZOBRIST_CASTLING[getCastlingRights(*state)];
+    if(hasEPTarget(*state)) {
+        state->key ^= ZOBRIST_EP[getFile(getEPTarget(*state))];
+    }
+    if(getTurn(*state)) {
+        state->key ^= ZOBRIST_TURN;
+    }
+}
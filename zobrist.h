@@ -0,0 +1,40 @@
+/**
+ * zobrist.h contains the random keys for Zobrist hashing, which gives
+ * each position a 64 bit key made by XORing a key for each piece on
+ * each square, the castling rights, the en passant file and the side
+ * to move. Make-move keeps the key up to date by XORing the keys of
+ * whatever changed. A second key covers only the pawns, for tables of
+ * pawn structure scores.
+ * @author Blake Herrera
+ * @date 2023-04-28
+ * @see https://www.chessprogramming.org/Zobrist_Hashing
+ */
+
+#ifndef ZOBRIST_H_INCLUDED
+#define ZOBRIST_H_INCLUDED
+
+#include "bitboard.h"
+#include "position.h"
+
+/* The key for no piece (the blockers index) is 0 on every square.
+ * ZOBRIST_CASTLING is indexed by all four castling rights at once,
+ * and ZOBRIST_EP by the file of the en passant target.
+ */
+extern bitmask ZOBRIST_PIECES[NUM_PIECES + 1][NUM_SQUARES],
+               ZOBRIST_CASTLING[16],
+               ZOBRIST_EP[8],
+               ZOBRIST_TURN;
+
+/**
+ * This function should be called on program start to generate the keys.
+ * The keys are the same on every run.
+ */
+void zobristInit();
+
+/**
+ * Computes a state's key and pawn key from scratch.
+ * @param state - Pointer to the state to set the keys of.
+ */
+void setZobristKeys(GameState *state);
+
+#endif // ZOBRIST_H_INCLUDED